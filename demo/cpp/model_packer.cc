@@ -0,0 +1,22 @@
+#include <dlr.h>
+
+#include <iostream>
+
+#include "dmlc/logging.h"
+
+/*! \brief Packs a TVM or RelayVM model folder into a single-file model archive, which
+ *         CreateDLRModelFromArchive() loads.
+ */
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    LOG(FATAL) << "Usage: " << argv[0] << " <model dir> <archive file>";
+    return 1;
+  }
+  if (PackDLRModel(argv[1], argv[2]) != 0) {
+    LOG(FATAL) << DLRGetLastError();
+    return 1;
+  }
+
+  std::cout << "Packed " << argv[1] << " into " << argv[2] << std::endl;
+  return 0;
+}
@@ -38,6 +38,11 @@ extern "C" {  // Open extern "C" block
  */
 typedef void* DLRModelHandle;
 
+/*!
+ \brief Handle for DLRBatcher.
+ */
+typedef void* DLRBatcherHandle;
+
 #ifndef DLR_ALLOC_TYPEDEF
 #define DLR_ALLOC_TYPEDEF
 /*! \brief A pointer to a malloc-like function. */
@@ -48,6 +53,14 @@ typedef void (*DLRFreeFunctionPtr)(void*);
 typedef void* (*DLRMemalignFunctionPtr)(size_t, size_t);
 #endif
 
+/*!
+ \brief Completion callback for RunDLRModelAsync() and RunDLRPipelineAsync().
+ \param status 0 for success, -1 for error. Call DLRGetLastError() from the callback to get the
+ error message.
+ \param user_data The pointer given to RunDLRModelAsync() or RunDLRPipelineAsync().
+ */
+typedef void (*DLRRunCallback)(int status, void* user_data);
+
 #ifndef DLR_MODEL_ELEM
 #define DLR_MODEL_ELEM
 enum DLRModelElemType {
@@ -57,7 +70,10 @@ enum DLRModelElemType {
   TVM_LIB,
   TVM_PARAMS,
   RELAY_EXEC,
-  TF2_SAVED_MODEL
+  TF2_SAVED_MODEL,
+  TVM_PARAMS_MMAP,
+  TVM_PARAMS_SHARED,
+  TVM_PARAMS_SHM
 };
 typedef struct ModelElem {
   const enum DLRModelElemType type;
@@ -68,7 +84,9 @@ typedef struct ModelElem {
 #endif
 
 /*!
- * \brief Creates a DLR model
+ * \brief Creates a DLR model. Graphs of a TVM model compiled for other batch sizes, listed in
+ *        "BatchVariants" of the metadata, are only loaded by this function. Their folders are
+ *        relative to the model folder, models created from elements or archives ignore them.
  * \param handle The pointer to save the model handle.
  * \param model_path Path to the folder containing the model files,
  *                   or colon-separated list of folders containing model files,
@@ -84,6 +102,7 @@ int CreateDLRModel(DLRModelHandle* handle, const char* model_path, int dev_type,
  \brief Creates a DLR model from model elements.
  \param handle The pointer to save the model handle.
  \param model_elems DLR Model elements. Element can be file path or data pointer in memory.
+        A TVM_LIB in memory (data and data_size) is loaded without writing it to disk on Linux.
  \param dev_type Device type. Valid values are in the DLDeviceType enum in dlpack.h.
  \param dev_id Device ID.
  \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
@@ -92,6 +111,75 @@ DLR_DLL
 int CreateDLRModelFromModelElem(DLRModelHandle* handle, const DLRModelElem* model_elems,
                                 size_t model_elems_size, int dev_type, int dev_id);
 
+/*!
+ \brief Creates a DLR model from a single-file model archive written by PackDLRModel(). The
+ archive is mapped once and its sections are loaded in place, TVM params as set by
+ DLR_TVM_PARAMS_MMAP, DLR_TVM_PARAMS_SHM or DLR_TVM_SHARE_PARAMS.
+ \param handle The pointer to save the model handle.
+ \param archive_path Path to the model archive.
+ \param dev_type Device type. Valid values are in the DLDeviceType enum in dlpack.h.
+ \param dev_id Device ID.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int CreateDLRModelFromArchive(DLRModelHandle* handle, const char* archive_path, int dev_type,
+                              int dev_id);
+
+/*!
+ \brief Packs the files of a TVM or RelayVM model into a single-file model archive.
+ \param model_path Path to the folder containing the model files, as for CreateDLRModel().
+ \param archive_path Path of the archive to write.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int PackDLRModel(const char* model_path, const char* archive_path);
+
+/*!
+ \brief Compresses a TVM params file, one zstd frame per weight. Compressed params are used in
+ place of the .params file of a model and are decompressed in parallel, straight into the
+ model's weights, on load. Requires DLR built with USE_ZSTD.
+ \param params_path Path to the params file.
+ \param out_path Path of the compressed params file to write.
+ \param level zstd compression level, 1 to 22.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int CompressDLRParams(const char* params_path, const char* out_path, int level);
+
+/*!
+ \brief Writes a snapshot of a loaded TVM model to a single-file model archive: graph, library,
+ metadata and the weights in their final layout. Restore it with CreateDLRModelFromArchive(),
+ which binds the weights in place from the mapped archive instead of copying them. The restore
+ still parses the graph and initializes the executor, which allocates storage for the weights
+ as well.
+ \param handle The model handle returned from CreateDLRModel().
+ \param path Path of the archive to write.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int SaveDLRModelSnapshot(DLRModelHandle* handle, const char* path);
+
+/*!
+ \brief Gets the number of timed phases of loading the model, 0 if its backend does not time
+ its loading.
+ \param handle The model handle returned from CreateDLRModel().
+ \param num_phases The pointer to save the number of phases.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int GetDLRNumLoadPhases(DLRModelHandle* handle, int* num_phases);
+
+/*!
+ \brief Gets the name and wall time of a phase of loading the model, in load order.
+ \param handle The model handle returned from CreateDLRModel().
+ \param index The phase index, from 0 to GetDLRNumLoadPhases() - 1.
+ \param name The pointer to save the phase name, valid as long as the model.
+ \param ms The pointer to save the phase time in milliseconds.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int GetDLRLoadPhase(DLRModelHandle* handle, int index, const char** name, double* ms);
+
 #ifdef DLR_TENSORFLOW2
 
 /*!
@@ -150,7 +238,21 @@ int CreateDLRPipeline(DLRModelHandle* handle, int num_models, const char** model
                       int dev_type, int dev_id);
 
 /*!
- \brief Deletes a DLR model.
+ * \brief Creates an execution context for a DLR model. The context shares the loaded module and
+ *        weights with the model, but owns its own input, output and intermediate storage, so
+ *        SetDLRInput/RunDLRModel/GetDLROutput sequences on different contexts can run
+ *        concurrently from different threads. The context is a regular model handle and must be
+ *        released with DeleteDLRModel(). Can only be used with TVM models (GraphExecutor).
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param context The pointer to save the context handle.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int CreateDLRExecutionContext(DLRModelHandle* handle, DLRModelHandle* context);
+
+/*!
+ \brief Deletes a DLR model. Must not be called while runs queued with RunDLRModelAsync() are
+ pending, i.e. before their callbacks have returned, nor from such a callback.
  \param handle The model handle returned from CreateDLRModel().
  \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
  message.
@@ -158,6 +260,44 @@ int CreateDLRPipeline(DLRModelHandle* handle, int num_models, const char** model
 DLR_DLL
 int DeleteDLRModel(DLRModelHandle* handle);
 
+/*!
+ * \brief Creates a batcher which coalesces concurrent requests to a model along the leading
+ *        (batch) dimension, runs them with a single inference and scatters the outputs back.
+ *        Supports TVM (batches are padded to the compiled batch size), RelayVM and Treelite
+ *        models whose inputs and outputs are all batch-major. The model must not be used
+ *        directly while the batcher exists.
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param max_batch Maximum number of rows run at once.
+ * \param max_delay_us Maximum time in microseconds a request waits for the batch to fill up.
+ * \param batcher The pointer to save the batcher handle.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int CreateDLRBatcher(DLRModelHandle* handle, int max_batch, int64_t max_delay_us,
+                     DLRBatcherHandle* batcher);
+
+/*!
+ * \brief Submits a request to a batcher and blocks until its outputs are written. Can be called
+ *        concurrently from multiple threads.
+ * \param batcher The batcher handle returned from CreateDLRBatcher().
+ * \param num_rows Number of rows (leading dimension) of the request.
+ * \param inputs Array with one row-major buffer per model input, in input index order.
+ * \param outputs Array with one row-major buffer per model output, in output index order. Each
+ *        buffer must hold num_rows rows of the output.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int SubmitDLRRequest(DLRBatcherHandle* batcher, int64_t num_rows, const void** inputs,
+                     void** outputs);
+
+/*!
+ * \brief Deletes a batcher. Requests which have not been run yet fail.
+ * \param batcher The batcher handle returned from CreateDLRBatcher().
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int DeleteDLRBatcher(DLRBatcherHandle* batcher);
+
 /*!
  \brief Runs a DLR model.
  \param handle The model handle returned from CreateDLRModel().
@@ -167,6 +307,59 @@ int DeleteDLRModel(DLRModelHandle* handle);
 DLR_DLL
 int RunDLRModel(DLRModelHandle* handle);
 
+/*!
+ \brief Resolves the inputs and outputs of a TVM model once, so RunDLRModelBound() can run
+ without name lookups. Input shapes are fixed to the current shapes.
+ \param handle The model handle returned from CreateDLRModel().
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int PrepareDLRBindings(DLRModelHandle* handle);
+
+/*!
+ \brief Copies inputs in, runs the model and copies outputs out in one call. Requires
+ PrepareDLRBindings().
+ \param handle The model handle returned from CreateDLRModel().
+ \param inputs One buffer per input, in the order of GetDLRInputName().
+ \param outputs One buffer per output, in output index order, large enough for the output sizes.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int RunDLRModelBound(DLRModelHandle* handle, const void** inputs, void** outputs);
+
+/*!
+ \brief Runs a DLR model on an internal worker pool and returns immediately. The callback is
+ invoked from a worker thread once inference finished. Inputs must not be changed and outputs
+ must not be read before the callback is called. The pool size is set by the
+ DLR_NUM_ASYNC_THREADS environment variable (default 2). The model must not be deleted before
+ the callback of every run queued on it has returned, the queued run uses the model.
+ \param handle The model handle returned from CreateDLRModel().
+ \param callback Function called when inference finished.
+ \param user_data Pointer passed to the callback.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int RunDLRModelAsync(DLRModelHandle* handle, DLRRunCallback callback, void* user_data);
+
+/*!
+ \brief Queues a request on a pipeline created with CreateDLRPipeline(). Every model of the
+ pipeline runs on its own thread, so consecutive requests overlap across models. Blocks only while
+ the queue of the first model is full. Do not use RunDLRModel() on the same pipeline afterwards.
+ \param handle The model handle returned from CreateDLRPipeline().
+ \param inputs One buffer per input, in input order, with the input shapes of the pipeline.
+ \param outputs One buffer per output, in output order, large enough for the output sizes.
+ \param callback Function called once outputs are written.
+ \param user_data Pointer passed to the callback.
+ \return 0 for success, -1 for error. Call DLRGetLastError() to get the error
+ message.
+ */
+DLR_DLL
+int RunDLRPipelineAsync(DLRModelHandle* handle, const void** inputs, void** outputs,
+                        DLRRunCallback callback, void* user_data);
+
 /*!
  \brief Gets the number of inputs.
  \param handle The model handle returned from CreateDLRModel().
@@ -221,7 +414,10 @@ DLR_DLL
 int GetDLRWeightName(DLRModelHandle* handle, int index, const char** weight_name);
 
 /*!
- \brief Sets the input according the node name.
+ \brief Sets the input according the node name. TVM models accept inputs whose batch (leading)
+        dimension differs from the compiled one: the batch is run in chunks of the compiled
+        size and GetDLROutputShape() reports outputs for the whole batch. Set
+        DLR_TVM_BATCH_CONTEXTS to run chunks on several executors in parallel.
  \param handle The model handle returned from CreateDLRModel().
  \param name The input node name.
  \param shape The input node shape as an array.
@@ -247,9 +443,10 @@ int SetDLRInputTensor(DLRModelHandle* handle, const char* name, void* tensor);
 
 /*!
  * \brief Sets the input from existing DLTensor without copying data. Can only be
- *        used with TVM models (GraphExecutor). Input tensor device must match the device of the
- *        model, and data must be alligned to 128 bytes. GetDLRInput cannot be used for inputs set
- *        via SetDLRInputZeroCopy.
+ *        used with TVM (GraphExecutor) and RelayVM models. Input tensor device must match the
+ *        device of the model, and data must be alligned to 64 bytes. For RelayVM models the data
+ *        must stay unchanged until RunDLRModel() returned. GetDLRInput cannot be used for inputs
+ *        set via SetDLRInputZeroCopy.
  * \param handle The model handle returned from CreateDLRModel().
  * \param name The input node name.
  * \param tensor The input DLTensor.
@@ -258,6 +455,23 @@ int SetDLRInputTensor(DLRModelHandle* handle, const char* name, void* tensor);
 DLR_DLL
 int SetDLRInputTensorZeroCopy(DLRModelHandle* handle, const char* name, void* tensor);
 
+/*!
+ * \brief Binds an existing DLTensor as the storage of the index-th output. For TVM models the
+ *        graph executor writes the output directly into it; the data must be aligned to 64
+ *        bytes and shape, type and device must match the output. RelayVM models allocate
+ *        their outputs, so the output is copied into the tensor at the end of every run; the
+ *        same alignment, shape and type rules apply, the tensor may be on the CPU or the model's
+ *        device. GetDLROutput() and GetDLROutputPtr() keep working while the tensor is bound.
+ *        Can only be used with TVM models (GraphExecutor and VMRuntime).
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param index The index-th output.
+ * \param tensor The output DLTensor, must stay valid while bound. NULL restores the model's
+ *        own output storage.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int SetDLROutputTensorZeroCopy(DLRModelHandle* handle, int index, void* tensor);
+
 /*!
  \brief Gets the current value of the input according the node name.
  \param handle The model handle returned from CreateDLRModel().
@@ -473,6 +687,7 @@ int UseDLRCPUAffinity(DLRModelHandle* handle, int use);
  * \brief Set custom allocator malloc function. Must be called before CreateDLRModel or
  *        CreateDLRPipeline. It is recommended to use with SetDLRCustomAllocatorFree and
  *        SetDLRCustomAllocatorMemalign.
+ *        Fails once a RelayVM model using the DLR pool (DLR_RELAYVM_ALLOCATOR=dlr) was loaded.
  * \param custom_memalign_fn Function pointer to memalign-like function.
  * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
  */
@@ -483,6 +698,7 @@ int SetDLRCustomAllocatorMalloc(DLRMallocFunctionPtr custom_malloc_fn);
  * \brief Set custom allocator free function. Must be called before CreateDLRModel or
  *        CreateDLRPipeline. It is recommended to use with SetDLRCustomAllocatorMalloc and
  *        SetDLRCustomAllocatorMemalign.
+ *        Fails once a RelayVM model using the DLR pool (DLR_RELAYVM_ALLOCATOR=dlr) was loaded.
  * \param custom_free_fn Function pointer to free-like function.
  * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
  */
@@ -493,12 +709,97 @@ int SetDLRCustomAllocatorFree(DLRFreeFunctionPtr custom_free_fn);
  * \brief Set custom allocator memalign function. memalign is used heavily by the TVM and RelayVM
  *        backends. Must be called before CreateDLRModel or CreateDLRPipeline. It is recommended
  *        to use with SetDLRCustomAllocatorMalloc and  SetDLRCustomAllocatorFree.
+ *        Fails once a RelayVM model using the DLR pool (DLR_RELAYVM_ALLOCATOR=dlr) was loaded.
  * \param custom_memalign_fn Function pointer to memalign-like function.
  * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
  */
 DLR_DLL
 int SetDLRCustomAllocatorMemalign(DLRMemalignFunctionPtr custom_memalign_fn);
 
+/*!
+ * \brief Allocates a host buffer for the given input: aligned for zero-copy use and sized for
+ *        the input shape and type. Buffers come from a pool which uses the custom allocator
+ *        functions if set. Passing the buffer to SetDLRInput() of a TVM model on CPU binds it in
+ *        place instead of copying it, so it must stay allocated and unchanged until the model
+ *        has run. Free with FreeDLRBuffer().
+ * \param handle The model handle returned from CreateDLRModel().
+ * \param name The input name, the input shape must be static.
+ * \param buffer Pointer to the allocated buffer.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int AllocDLRInputBuffer(DLRModelHandle* handle, const char* name, void** buffer);
+
+/*!
+ * \brief Returns a buffer allocated by AllocDLRInputBuffer() to the pool. The buffer must not be
+ *        bound to a model input anymore, i.e. another input was set or the model was deleted.
+ * \param buffer The buffer to free.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int FreeDLRBuffer(void* buffer);
+
+/*!
+ * \brief Gets statistics of the DLR memory pool of RelayVM models on CPU. The pool is opt-in:
+ *        it is used by models loaded with DLR_RELAYVM_ALLOCATOR=dlr (or "RelayVMAllocator":
+ *        "dlr" in the metadata), others use TVM's pool.
+ *
+ *        The pool is installed as TVM's CPU allocator when the first such model is loaded, and
+ *        stays installed for the rest of the process. TVM has a single CPU allocator, so from
+ *        then on host allocations of every model (TVM models included) go through the pool and
+ *        are counted here. It keeps at most 256 MiB of freed buffers, see
+ *        SetDLRRelayVMPoolLimit(). The pool is not installed if any custom allocator function
+ *        was set, and custom allocator functions cannot be set once it is installed.
+ * \param bytes_cached Bytes of freed buffers kept for reuse.
+ * \param bytes_in_use Bytes of buffers currently held by models.
+ * \param hit_rate Fraction of allocations served from cached buffers, 0 if nothing was
+ *        allocated yet.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int GetDLRRelayVMPoolStats(size_t* bytes_cached, size_t* bytes_in_use, float* hit_rate);
+
+/*!
+ * \brief Limits the bytes the RelayVM memory pool keeps for reuse. Cached buffers above the
+ *        limit are released immediately, buffers freed while the limit is reached are returned
+ *        to the system. The default limit is 256 MiB.
+ * \param max_cached_bytes The maximum number of cached bytes.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int SetDLRRelayVMPoolLimit(size_t max_cached_bytes);
+
+/*!
+ * \brief Releases all buffers the RelayVM memory pool keeps for reuse. Buffers held by models
+ *        are not affected.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int TrimDLRRelayVMPool();
+
+/*!
+ * \brief Gets statistics of the store which keeps weights of TVM models loaded with
+ *        DLR_TVM_SHARE_PARAMS=1 (or TVM_PARAMS_SHARED elements). Weights of identical contents
+ *        are stored once for all such models in the process.
+ * \param stored_bytes Bytes of the distinct weights held by the store.
+ * \param deduplicated_bytes Bytes the models would have needed on top of stored_bytes without
+ *        sharing.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int GetDLRParamStoreStats(size_t* stored_bytes, size_t* deduplicated_bytes);
+
+/*!
+ * \brief Removes the shared memory segment holding the weights of a TVM model loaded with
+ *        DLR_TVM_PARAMS_SHM=1 (or TVM_PARAMS_SHM elements). Segments outlive the processes
+ *        using them, this releases their memory once no process needs them anymore. Models
+ *        using the segment keep their mapping, models loaded later create a new segment.
+ * \param model_path Path to the model as for CreateDLRModel(), or to a model archive.
+ * \return 0 for success, -1 for error. Call DLRGetLastError() to get the error message.
+ */
+DLR_DLL
+int RemoveDLRSharedParams(const char* model_path);
+
 /*! \} */
 
 #ifdef __cplusplus
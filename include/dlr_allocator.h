@@ -1,8 +1,12 @@
 #ifndef DLR_ALLOCATOR_H_
 #define DLR_ALLOCATOR_H_
 
+#include <atomic>
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 
 #if defined(_MSC_VER) || defined(_WIN32)
 #define DLR_DLL __declspec(dllexport)
@@ -67,6 +71,104 @@ class DLR_DLL DLRAllocatorFunctions {
 
   /*! \brief Free data, using custom free if set, otherwise use free. */
   static void Free(void* ptr);
+
+  /*! \brief Allocate aligned data, using custom memalign if it is set along with a custom free,
+   *         otherwise the system aligned allocator. Release with the function returned in
+   *         free_fn, the allocator functions may change before the data is freed.
+   */
+  static void* Memalign(size_t alignment, size_t size, DLRFreeFunctionPtr* free_fn);
+
+  /*! \brief Allocate aligned data with the system aligned allocator. */
+  static void* SystemMemalign(size_t alignment, size_t size);
+
+  /*! \brief Free data from SystemMemalign. */
+  static void SystemAlignedFree(void* ptr);
+};
+
+/*! \brief Counters of a DLRBufferPool. */
+struct DLRBufferPoolStats {
+  /*! \brief Bytes of freed buffers kept for reuse. */
+  size_t bytes_cached = 0;
+  /*! \brief Bytes of buffers handed out and not freed yet. */
+  size_t bytes_in_use = 0;
+  /*! \brief Allocations served from cached buffers. */
+  size_t num_hits = 0;
+  /*! \brief Allocations which needed a new buffer. */
+  size_t num_misses = 0;
+};
+
+/*! \brief Pool of aligned host buffers. Requests are rounded up to size classes (four per power
+ *         of two, so at most a quarter of a buffer is unused) and freed buffers are handed out
+ *         again for requests of the same class, so buffers allocated per request come from the
+ *         pool in a steady state even when sizes vary slightly. At most max_cached_bytes are
+ *         kept, buffers freed beyond that are released.
+ */
+class DLR_DLL DLRBufferPool {
+ private:
+  /*! \brief Buffer with the function releasing it, recorded when it was allocated. */
+  struct Block {
+    void* ptr;
+    size_t size_class;
+    DLRFreeFunctionPtr free_fn;
+  };
+  std::mutex mutex_;
+  /*! \brief Buffers handed out and not freed yet, by address. */
+  std::unordered_map<void*, Block> in_use_;
+  /*! \brief Buffers available for reuse, by size class. */
+  std::unordered_multimap<size_t, Block> free_;
+  size_t max_cached_bytes_ = SIZE_MAX;
+  DLRBufferPoolStats stats_;
+  static std::atomic<bool> relay_vm_hook_installed_;
+
+  /*! \brief Release cached buffers until at most max_bytes are cached. Requires mutex_. */
+  void ReleaseCached(size_t max_bytes);
+
+ public:
+  /*! \brief Alignment of all buffers, enough for TVM zero-copy inputs and SIMD loads. */
+  static const size_t kAlignment = 64;
+
+  DLRBufferPool() = default;
+  ~DLRBufferPool();
+  DLRBufferPool(const DLRBufferPool&) = delete;
+  DLRBufferPool& operator=(const DLRBufferPool&) = delete;
+
+  /*! \brief Size of the buffer handed out for a request of size bytes. */
+  static size_t SizeClass(size_t size);
+
+  void* Alloc(size_t size);
+  /*! \brief Return a buffer to the pool. Throws if ptr was not allocated by this pool. */
+  void Free(void* ptr);
+  /*! \brief Return a buffer to the pool, returns false if ptr was not allocated by this pool. */
+  bool Release(void* ptr);
+  /*! \brief Check whether ptr is a buffer currently handed out by this pool. */
+  bool Contains(const void* ptr);
+  /*! \brief Release all buffers kept for reuse. */
+  void Trim();
+  /*! \brief Limit the bytes kept for reuse, releasing cached buffers above the limit. */
+  void SetMaxCachedBytes(size_t max_cached_bytes);
+  DLRBufferPoolStats GetStats();
+
+  /*! \brief Pool of buffers from AllocDLRInputBuffer. */
+  static DLRBufferPool& Global();
+  /*! \brief Bytes RelayVM() keeps for reuse unless changed with SetMaxCachedBytes. */
+  static const size_t kRelayVMMaxCachedBytes = size_t{256} << 20;
+
+  /*! \brief Pool behind TVM host allocations of RelayVM models using the "dlr" allocator. The
+   *         hook is process-wide, once installed it serves host allocations of all models.
+   */
+  static DLRBufferPool& RelayVM();
+  /*! \brief Record that RelayVM() was installed as TVM's CPU allocator. Called before
+   *         installing it, custom allocator functions must not be set from then on.
+   */
+  static void SetRelayVMHookInstalled();
+  static bool IsRelayVMHookInstalled();
+  /*! \brief memalign-like and free-like functions over RelayVM(), in the form TVM takes as a
+   *         custom CPU allocator. Pointers not allocated by the pool are TVM's own or aligned
+   *         beyond kAlignment, both come from the system aligned allocator and are freed with
+   *         SystemAlignedFree.
+   */
+  static void* RelayVMMemalign(size_t alignment, size_t size);
+  static void RelayVMFree(void* ptr);
 };
 
 /*! \brief STL-compatible allocator using allocator functions from DLRAllocatorFunctions. */
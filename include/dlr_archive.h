@@ -0,0 +1,68 @@
+#ifndef DLR_ARCHIVE_H_
+#define DLR_ARCHIVE_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "dlr_common.h"
+
+#if defined(_MSC_VER) || defined(_WIN32)
+#define DLR_DLL __declspec(dllexport)
+#else
+#define DLR_DLL
+#endif  // defined(_MSC_VER) || defined(_WIN32)
+
+namespace dlr {
+
+/*! \brief Single-file model: a ModelArchiveHeader, num_sections ModelArchiveSection entries and
+ *         the data of each section, at offsets aligned to kModelArchiveAlignment. Integers are
+ *         little endian.
+ */
+constexpr char kModelArchiveMagic[8] = {'D', 'L', 'R', 'A', 'R', 'C', 'H', '\0'};
+constexpr uint32_t kModelArchiveVersion = 1;
+/*! \brief Sections start at page boundaries, so each can be mapped and paged in on its own. */
+constexpr uint64_t kModelArchiveAlignment = 4096;
+
+struct ModelArchiveHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t num_sections;
+};
+
+struct ModelArchiveSection {
+  /*! \brief DLRModelElemType of the section. */
+  uint32_t type;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+};
+
+/*! \brief Model archive mapped into memory. Its elements point into the mapping, which must
+ *         outlive models aliasing them.
+ */
+class DLR_DLL ModelArchive {
+ private:
+  std::shared_ptr<const MemoryMappedFile> file_;
+  std::vector<DLRModelElem> elems_;
+
+ public:
+  explicit ModelArchive(const std::string& path);
+
+  const std::vector<DLRModelElem>& GetElems() const { return elems_; }
+  const std::shared_ptr<const MemoryMappedFile>& GetFile() const { return file_; }
+
+  /*! \brief Write the graph, params, relay executable, metadata and library of a TVM or
+   *         RelayVM model to an archive.
+   */
+  static void Pack(const std::vector<std::string>& files, const std::string& archive_path);
+  /*! \brief Write an archive of the given sections, by element type and contents. */
+  static void Write(const std::vector<std::pair<DLRModelElemType, std::string>>& sections,
+                    const std::string& archive_path);
+};
+
+}  // namespace dlr
+
+#endif  // DLR_ARCHIVE_H_
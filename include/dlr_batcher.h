@@ -0,0 +1,81 @@
+#ifndef DLR_BATCHER_H_
+#define DLR_BATCHER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+#include "dlr_common.h"
+
+#if defined(_MSC_VER) || defined(_WIN32)
+#define DLR_DLL __declspec(dllexport)
+#else
+#define DLR_DLL
+#endif  // defined(_MSC_VER) || defined(_WIN32)
+
+namespace dlr {
+
+/*! \brief Single request submitted to DLRBatcher. Inputs and outputs are row-major buffers whose
+ *         leading dimension is num_rows.
+ */
+struct DLRBatchRequest {
+  int64_t num_rows;
+  const void* const* inputs;
+  void* const* outputs;
+  std::chrono::steady_clock::time_point submit_time;
+  bool done = false;
+  /*! \brief Error of the batch the request ran in, rethrown by Submit(). */
+  std::exception_ptr error;
+};
+
+/*! \brief Coalesces concurrent requests along the leading (batch) dimension and runs them with a
+ *         single DLRModel::Run() call. Models with a static batch dimension (TVM) get the batch
+ *         padded to the compiled size, models with a dynamic batch dimension (RelayVM, Treelite)
+ *         run with the number of rows collected. All inputs and outputs of the model must be
+ *         batch-major. The batcher is the only user of the model while it exists.
+ */
+class DLR_DLL DLRBatcher {
+ private:
+  DLRModel* model_;
+  int64_t max_batch_;
+  std::chrono::microseconds max_delay_;
+  /*! \brief Compiled batch size, or -1 if the model accepts any number of rows. */
+  int64_t fixed_batch_ = -1;
+  std::vector<std::string> input_names_;
+  std::vector<std::vector<int64_t>> input_shapes_;
+  std::vector<size_t> input_row_bytes_;
+  std::vector<size_t> output_type_bytes_;
+  /*! \brief Staging buffers, reused across batches. */
+  std::vector<std::vector<char, DLRAllocator<char>>> input_buffers_;
+  std::vector<std::vector<char, DLRAllocator<char>>> output_buffers_;
+
+  std::mutex mutex_;
+  std::condition_variable queue_cv_;
+  std::condition_variable done_cv_;
+  std::deque<DLRBatchRequest*> queue_;
+  int64_t queued_rows_ = 0;
+  /*! \brief Submit() calls not returned yet, the destructor waits for them. */
+  int num_waiting_ = 0;
+  int64_t num_runs_ = 0;
+  bool stop_ = false;
+  std::thread worker_;
+
+  void WorkerLoop();
+  void RunBatch(const std::vector<DLRBatchRequest*>& batch, int64_t num_rows);
+
+ public:
+  DLRBatcher(DLRModel* model, int64_t max_batch, int64_t max_delay_us);
+  ~DLRBatcher();
+
+  /*! \brief Submit a request and block until its outputs have been written. */
+  void Submit(int64_t num_rows, const void* const* inputs, void* const* outputs);
+  /*! \brief Number of times the model was run. */
+  int64_t GetNumRuns();
+};
+
+}  // namespace dlr
+
+#endif  // DLR_BATCHER_H_
@@ -6,6 +6,10 @@
 #include <runtime_base.h>
 #include <sys/types.h>
 
+#include <chrono>
+#include <functional>
+#include <future>
+#include <mutex>
 #include <nlohmann/json.hpp>
 #include <set>
 #include <string>
@@ -49,7 +53,10 @@ enum DLRModelElemType {
   TVM_LIB,
   TVM_PARAMS,
   RELAY_EXEC,
-  TF2_SAVED_MODEL
+  TF2_SAVED_MODEL,
+  TVM_PARAMS_MMAP,
+  TVM_PARAMS_SHARED,
+  TVM_PARAMS_SHM
 };
 typedef struct ModelElem {
   const DLRModelElemType type;
@@ -92,6 +99,48 @@ DLR_DLL void LoadJsonFromFile(const std::string& path, nlohmann::json& jsonObjec
 DLR_DLL std::string LoadFileToString(const std::string& path,
                                      std::ios_base::openmode mode = std::ios_base::in);
 
+/*! \brief Read-only view of a whole file mapped into memory. On platforms without mmap the file
+ *         is read into a buffer instead.
+ */
+class DLR_DLL MemoryMappedFile {
+ private:
+  const char* data_ = nullptr;
+  size_t size_ = 0;
+#ifdef _WIN32
+  std::string buffer_;
+#endif
+
+ public:
+  explicit MemoryMappedFile(const std::string& path);
+  ~MemoryMappedFile();
+  MemoryMappedFile(const MemoryMappedFile&) = delete;
+  MemoryMappedFile& operator=(const MemoryMappedFile&) = delete;
+
+  const char* GetData() const { return data_; }
+  size_t GetSize() const { return size_; }
+};
+
+/*! \brief Shared library given in memory, exposed as a path the dynamic loader accepts: an
+ *         anonymous memory file (memfd) on Linux, a temporary file on other UNIX platforms.
+ *         Must outlive the loaded library, the loader may match a later library of the same
+ *         path to it otherwise.
+ */
+class DLR_DLL InMemoryLibrary {
+ private:
+  std::string path_;
+  int fd_ = -1;
+  bool temp_file_ = false;
+
+ public:
+  InMemoryLibrary(const void* data, size_t size);
+  ~InMemoryLibrary();
+  InMemoryLibrary(const InMemoryLibrary&) = delete;
+  InMemoryLibrary& operator=(const InMemoryLibrary&) = delete;
+
+  /*! \brief Path to pass to dlopen(), it has no file extension. */
+  const std::string& GetPath() const { return path_; }
+};
+
 inline bool StartsWith(const std::string& mainStr, const std::string& toMatch) {
   return mainStr.size() >= toMatch.size() && mainStr.compare(0, toMatch.size(), toMatch) == 0;
 }
@@ -126,12 +175,37 @@ DLR_DLL std::vector<std::string> MakePathVec(std::string model_path);
 
 bool HasNegative(const int64_t* arr, const size_t size);
 
+/*! \brief Get the size in bytes of one element of a type string such as "float32" or "int8".
+ */
+size_t GetDataTypeBytes(const std::string& type);
+
 #define CHECK_SHAPE(msg, value, expected) \
   CHECK_EQ(value, expected) << (msg) << ". Value read: " << (value) << ", Expected: " << (expected);
 
+/*! \brief Times consecutive phases of work, each Mark() records the time since the previous
+ *         one.
+ */
+class PhaseTimer {
+ private:
+  std::vector<std::pair<std::string, double>>* phases_;
+  std::chrono::steady_clock::time_point last_;
+
+ public:
+  explicit PhaseTimer(std::vector<std::pair<std::string, double>>* phases)
+      : phases_(phases), last_(std::chrono::steady_clock::now()) {}
+
+  void Mark(const std::string& name) {
+    const auto now = std::chrono::steady_clock::now();
+    phases_->emplace_back(name, std::chrono::duration<double, std::milli>(now - last_).count());
+    last_ = now;
+  }
+};
+
 // Abstract class
 class DLR_DLL DLRModel {
  protected:
+  /*! \brief Wall time of each phase of loading the model in milliseconds, in load order. */
+  std::vector<std::pair<std::string, double>> load_phases_;
   std::string version_;
   DLRBackend backend_;
   size_t num_inputs_ = 1;
@@ -141,6 +215,8 @@ class DLR_DLL DLRModel {
   std::vector<std::string> input_names_;
   std::vector<std::string> input_types_;
   std::vector<std::vector<int64_t>> input_shapes_;
+  /*! \brief Serializes asynchronous runs of this model. */
+  std::shared_ptr<std::mutex> run_mutex_ = std::make_shared<std::mutex>();
   virtual void ValidateDeviceTypeIfExists();
 
  public:
@@ -184,10 +260,25 @@ class DLR_DLL DLRModel {
 
   virtual DLDeviceType GetDeviceTypeFromMetadata() const;
   virtual DLRBackend GetBackend() { return backend_; }
+  const DLDevice& GetDevice() const { return dev_; }
   virtual void SetNumThreads(int threads) = 0;
   virtual bool HasMetadata() const;
   virtual void UseCPUAffinity(bool use) = 0;
   virtual void Run() = 0;
+  /*! \brief Run the model on the shared async worker pool. Inputs must not be modified and
+   *         outputs must not be read until the returned future is ready. Use execution contexts
+   *         to prepare the next request while this one is running. The optional callback is
+   *         called from the worker thread with the error of the run, if any. The queued run
+   *         holds this model, which must outlive the callback.
+   */
+  virtual std::future<void> RunAsync(
+      std::function<void(std::exception_ptr)> callback = std::function<void(std::exception_ptr)>());
+  /*! \brief Name and milliseconds of each phase of loading, empty if the backend does not
+   *         time its loading.
+   */
+  const std::vector<std::pair<std::string, double>>& GetLoadPhases() const {
+    return load_phases_;
+  }
 };
 
 typedef std::shared_ptr<DLRModel> DLRModelPtr;
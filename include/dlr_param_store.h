@@ -0,0 +1,164 @@
+#ifndef DLR_PARAM_STORE_H_
+#define DLR_PARAM_STORE_H_
+
+#include <dlpack/dlpack.h>
+#include <tvm/runtime/ndarray.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#if defined(_MSC_VER) || defined(_WIN32)
+#define DLR_DLL __declspec(dllexport)
+#else
+#define DLR_DLL
+#endif  // defined(_MSC_VER) || defined(_WIN32)
+
+namespace dlr {
+
+/*! \brief Counters of a ParamStore. */
+struct ParamStoreStats {
+  /*! \brief Bytes of the distinct tensors held by the store. */
+  size_t stored_bytes = 0;
+  /*! \brief Bytes requested beyond stored_bytes, i.e. saved by sharing identical tensors. */
+  size_t deduplicated_bytes = 0;
+  size_t num_tensors = 0;
+};
+
+/*! \brief Process-wide store of model weights keyed by a hash of their contents, so identical
+ *         weights of different models are kept once. Tensors are reference counted: each
+ *         Acquire() must be matched by a Release() of the returned array.
+ */
+class DLR_DLL ParamStore {
+ private:
+  struct Entry {
+    tvm::runtime::NDArray array;
+    size_t num_refs;
+  };
+  std::mutex mutex_;
+  /*! \brief Tensors by content hash, several for the rare hash collision. */
+  std::unordered_map<uint64_t, std::vector<Entry>> entries_;
+  /*! \brief Content hash of each stored tensor, by data pointer. */
+  std::unordered_map<const void*, uint64_t> hashes_;
+  ParamStoreStats stats_;
+
+ public:
+  ParamStore() = default;
+  ParamStore(const ParamStore&) = delete;
+  ParamStore& operator=(const ParamStore&) = delete;
+
+  /*! \brief Hash of the bytes of a tensor. */
+  static uint64_t Hash(const void* data, size_t size);
+
+  /*! \brief Get an array on dev with the contents of tensor, a contiguous host tensor. */
+  tvm::runtime::NDArray Acquire(const DLTensor& tensor, const DLDevice& dev);
+  /*! \brief Drop a reference to an array from Acquire(), the array is freed with the last one. */
+  void Release(const tvm::runtime::NDArray& array);
+  ParamStoreStats GetStats();
+
+  static ParamStore& Global();
+};
+
+/*! \brief Named shared memory segment, mapped read-only, which processes fill once and then
+ *         share. The process creating the segment fills it while the others wait. Segments
+ *         outlive the processes using them, so the name must change with the contents.
+ */
+class DLR_DLL SharedMemorySegment {
+ private:
+  void* addr_ = nullptr;
+  size_t mapped_size_ = 0;
+  size_t size_ = 0;
+
+  SharedMemorySegment() = default;
+  /*! \brief Size and fill a segment just created, fd is closed. */
+  static std::unique_ptr<SharedMemorySegment> Create(int fd, const std::string& name, size_t size,
+                                                     const std::function<void(char*)>& fill);
+  /*! \brief Map an existing segment once complete, fd is closed. */
+  static std::unique_ptr<SharedMemorySegment> Open(int fd, const std::string& name, size_t size);
+
+ public:
+  ~SharedMemorySegment();
+  SharedMemorySegment(const SharedMemorySegment&) = delete;
+  SharedMemorySegment& operator=(const SharedMemorySegment&) = delete;
+
+  /*! \brief Map the segment of the given name, creating it and writing its contents with fill
+   *         if it does not exist yet. Data is aligned to 64 bytes.
+   *         Segments are only accessible to their owner and only segments owned by the
+   *         current user are mapped. Callers still check the contents before use.
+   *  \return nullptr if the segment is not available, e.g. left incomplete by a process which
+   *          died while creating it, owned by another user or not supported on the platform.
+   *          Segments found sized but not ready are removed, so the next process creates them
+   *          again. Empty ones are removed and created again. Others are left alone, as they
+   *          may only be slow to appear, and stay until removed.
+   */
+  static std::unique_ptr<SharedMemorySegment> OpenOrCreate(
+      const std::string& name, size_t size, const std::function<void(char*)>& fill);
+  /*! \brief Remove the segment of the given name, mappings stay valid. */
+  static void Remove(const std::string& name);
+
+  const char* GetData() const;
+  size_t GetSize() const { return size_; }
+};
+
+/*! \brief Name of the shared memory segment holding the weights of a params blob. */
+DLR_DLL std::string GetSharedParamsName(const char* params_data, size_t params_size);
+
+/*! \brief Walk a params blob (format of tvm::runtime::SaveParams, or a params snapshot) and
+ *         call fn with the name of each weight, its shape and a host view of its data inside the
+ *         blob.
+ *  \return Names of all weights.
+ */
+DLR_DLL std::vector<std::string> ForEachParam(
+    const char* params_data, size_t params_size,
+    const std::function<void(const std::string&, std::vector<int64_t>*, DLTensor*)>& fn);
+
+/*! \brief Compressed params blob: kCompressedParamsMagic, version and codec (uint32 each), the
+ *         weight names, then for each weight its dtype, ndim, shape, size, frame offset and
+ *         frame size, followed by the frames. Each weight is one zstd frame, so weights are
+ *         decompressed independently and in parallel. Frame offsets are relative to the first
+ *         frame.
+ */
+constexpr char kCompressedParamsMagic[8] = {'D', 'L', 'R', 'Z', 'P', 'R', 'M', '\0'};
+constexpr uint32_t kCompressedParamsVersion = 1;
+constexpr uint32_t kCompressedParamsCodecZstd = 1;
+
+/*! \brief Weight of a compressed params blob, frame points into the blob. */
+struct CompressedParam {
+  std::string name;
+  DLDataType dtype;
+  std::vector<int64_t> shape;
+  /*! \brief Decompressed bytes. */
+  uint64_t size;
+  const char* frame;
+  uint64_t frame_size;
+};
+
+DLR_DLL bool IsCompressedParams(const char* data, size_t size);
+/*! \brief Read the weights of a compressed params blob without decompressing them. */
+DLR_DLL std::vector<CompressedParam> ReadCompressedParams(const char* data, size_t size);
+/*! \brief Decompress a weight to dst, which holds param.size bytes. */
+DLR_DLL void DecompressParam(const CompressedParam& param, void* dst);
+/*! \brief Compress a params blob (format of tvm::runtime::SaveParams) at the given zstd level. */
+DLR_DLL std::string CompressParams(const char* params_data, size_t params_size, int level);
+
+/*! \brief Params snapshot, the weights of a loaded model in their final layout:
+ *         kParamsSnapshotMagic, version and reserved (uint32 each), the weight names, then for
+ *         each weight its dtype, ndim, shape, offset and size, followed by the data. The data
+ *         starts at the first aligned offset after the index and weights are kAllocAlignment
+ *         aligned within it, so a snapshot loaded at an aligned address is bound as is.
+ */
+constexpr char kParamsSnapshotMagic[8] = {'D', 'L', 'R', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t kParamsSnapshotVersion = 1;
+
+DLR_DLL bool IsParamsSnapshot(const char* data, size_t size);
+/*! \brief Write a params snapshot of host arrays. */
+DLR_DLL std::string WriteParamsSnapshot(const std::vector<std::string>& names,
+                                        const std::vector<tvm::runtime::NDArray>& arrays);
+
+}  // namespace dlr
+
+#endif  // DLR_PARAM_STORE_H_
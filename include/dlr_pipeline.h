@@ -3,6 +3,11 @@
 
 #include <tvm/runtime/memory.h>
 
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+#include "dlr_allocator.h"
 #include "dlr_common.h"
 
 #if defined(_MSC_VER) || defined(_WIN32)
@@ -13,15 +18,100 @@
 
 namespace dlr {
 
+/*! \brief Blocking queue with a fixed capacity, used between pipeline stages.
+ */
+template <typename T>
+class BoundedQueue {
+ private:
+  std::deque<T> items_;
+  size_t capacity_;
+  bool closed_ = false;
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+
+ public:
+  explicit BoundedQueue(size_t capacity) : capacity_(capacity > 0 ? capacity : 1) {}
+
+  /*! \brief Blocks while the queue is full. Returns false if the queue was closed. */
+  bool Push(T item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return closed_ || items_.size() < capacity_; });
+    if (closed_) return false;
+    items_.push_back(std::move(item));
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /*! \brief Blocks while the queue is empty. Returns false once closed and drained. */
+  bool Pop(T* item) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !items_.empty(); });
+    if (items_.empty()) return false;
+    *item = std::move(items_.front());
+    items_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+};
+
+/*! \brief Request travelling through the stages of a pipelined PipelineModel.
+ */
+struct PipelineRequest {
+  std::vector<const void*> inputs;
+  std::vector<std::vector<int64_t>> input_shapes;
+  std::vector<void*> outputs;
+  /*! \brief Outputs of the previous stage, owned by the request as the stage moves on. */
+  std::vector<std::vector<int64_t>> tensor_shapes;
+  std::vector<std::vector<char, DLRAllocator<char>>> tensors;
+  std::function<void(std::exception_ptr)> callback;
+  std::promise<void> done;
+};
+
 /*! \brief class PipelineModel
  */
 class DLR_DLL PipelineModel : public DLRModel {
  private:
+  typedef std::shared_ptr<PipelineRequest> PipelineRequestPtr;
+  static const size_t kDefaultQueueCapacity = 2;
+
   int count_;
   const std::vector<DLRModelPtr> dlr_models_;
+  /*! \brief Whether output/input compatibility of models i-1 and i depends on runtime shapes.
+   *         Static shapes are fully checked once in SetupPipelineModel.
+   */
+  std::vector<bool> runtime_check_required_;
+  /*! \brief Output shapes of model i-1 last checked against the inputs of model i. */
+  std::vector<std::vector<std::vector<int64_t>>> checked_shapes_;
+  /*! \brief Whether outputs of model i-1 may be bound to the inputs of model i without a copy,
+   *         true when both models are TVM or RelayVM.
+   */
+  std::vector<bool> zero_copy_;
+  /*! \brief Data bound to input j of TVM model i by zero-copy hand-off, nullptr if copied.
+   *         RelayVM inputs are bound anew on each run.
+   */
+  std::vector<std::vector<const void*>> bound_inputs_;
+  /*! \brief Pipelined mode: stage i runs on stage_threads_[i] and takes requests from
+   *         stage_queues_[i].
+   */
+  std::vector<std::unique_ptr<BoundedQueue<PipelineRequestPtr>>> stage_queues_;
+  std::vector<std::thread> stage_threads_;
+  std::mutex pipeline_mutex_;
+
   void CheckModelsCompatibility(const DLRModelPtr& m0, const DLRModelPtr& m1, const int m1_id,
                                 const bool is_runtime_check);
   void SetupPipelineModel();
+  bool HandOffZeroCopy(int stage, int index);
+  void ResetZeroCopyBindings();
+  void StageLoop(int stage);
+  void RunStage(int stage, PipelineRequest* request);
 
  public:
   /*! \brief Load model files from given folder path.
@@ -30,6 +120,7 @@ class DLR_DLL PipelineModel : public DLRModel {
       : DLRModel(dev, DLRBackend::kPIPELINE), dlr_models_(dlr_models) {
     SetupPipelineModel();
   }
+  ~PipelineModel();
 
   virtual const int GetInputDim(int index) const override;
   virtual const int64_t GetInputSize(int index) const override;
@@ -58,6 +149,27 @@ class DLR_DLL PipelineModel : public DLRModel {
   virtual const char* GetOutputName(const int index) const override;
   virtual int GetOutputIndex(const char* name) const override;
   virtual void GetOutputByName(const char* name, void* out) override;
+
+  /*! \brief Start pipelined mode: every model runs on its own thread and hands its outputs to
+   *         the next one through a queue holding up to queue_capacity requests, so throughput
+   *         is bound by the slowest model instead of the sum of all models. Run() must not be
+   *         used while pipelined mode is active. Called by RunPipelined if needed.
+   */
+  void StartPipeline(size_t queue_capacity = kDefaultQueueCapacity);
+
+  /*! \brief Finish queued requests and stop the stage threads. */
+  void StopPipeline();
+
+  /*! \brief Queue a request in pipelined mode. Blocks while the first stage queue is full.
+   *  \param inputs One buffer per input, kept alive by the caller until the request is done.
+   *  \param input_shapes One shape per input, or nullptr to use GetInputShape().
+   *  \param outputs One buffer per output, large enough for GetOutputSizeDim() elements.
+   *  \param callback Called from the last stage thread once outputs are written or an error
+   *         occurred.
+   */
+  std::future<void> RunPipelined(
+      const void* const* inputs, const int64_t* const* input_shapes, void* const* outputs,
+      std::function<void(std::exception_ptr)> callback = std::function<void(std::exception_ptr)>());
 };
 
 }  // namespace dlr
@@ -36,17 +36,61 @@
 
 namespace dlr {
 
+/*! \brief Copy the leading region common to two row-major arrays of the same rank. */
+DLR_DLL void CopyRegion(const char* src, const int64_t* src_shape, char* dst,
+                        const int64_t* dst_shape, int ndim, size_t elem_bytes);
+
+/*! \brief Cut the dimensions of shape, an output of a run on padded inputs, which are dynamic
+ *         in metadata_shape and have a padded length back to the length given by the caller.
+ *  \param padded_lengths Padded length and length given by the caller of each padded input
+ *         dimension.
+ *  \return false if no dimension was cut.
+ */
+DLR_DLL bool GetSlicedOutputShape(const std::vector<int64_t>& metadata_shape,
+                                  const std::vector<std::pair<int64_t, int64_t>>& padded_lengths,
+                                  std::vector<int64_t>* shape);
+
 class DLR_DLL RelayVMModel : public DLRModel {
  private:
   static const std::string ENTRY_FUNCTION;
   std::vector<std::string> output_names_;
   std::vector<std::string> output_types_;
+  /*! \brief Backing file of the operator library when TVM_LIB was given in memory, declared
+   *         first to outlive the library.
+   */
+  std::unique_ptr<InMemoryLibrary> lib_memory_;
   std::shared_ptr<tvm::runtime::Module> vm_module_;
   std::shared_ptr<tvm::runtime::Module> vm_executable_;
+  /*! \brief VM functions and argument storage used by Run(), resolved once at load time. */
+  tvm::runtime::PackedFunc set_input_;
+  tvm::runtime::PackedFunc invoke_;
+  std::vector<TVMValue> input_values_;
+  std::vector<int> input_type_codes_;
   std::vector<tvm::runtime::NDArray> inputs_;
+  /*! \brief Input buffers kept per shape, so inputs alternating between shapes are not
+   *         reallocated. At most kMaxInputBuffers per input, the oldest is dropped first.
+   */
+  std::vector<std::vector<tvm::runtime::NDArray>> input_buffers_;
+  /*! \brief Lengths dynamic input dimensions are padded up to, sorted. From "ShapeBuckets" in
+   *         metadata, empty if bucketing is off.
+   */
+  std::vector<int64_t> shape_buckets_;
+  /*! \brief Shape given by the caller for inputs which were padded, empty otherwise. */
+  std::vector<std::vector<int64_t>> unpadded_shapes_;
+  /*! \brief Scratch for the padded shape of an input. */
+  std::vector<int64_t> padded_shape_;
+  /*! \brief Host staging for padding inputs of models not on CPU. */
+  std::vector<char> pad_staging_;
+  /*! \brief Buffers for outputs sliced back from padded lengths, kept per shape. */
+  std::vector<std::vector<tvm::runtime::NDArray>> output_buffers_;
   tvm::runtime::ObjectRef output_ref_;
   std::vector<tvm::runtime::NDArray> outputs_;
   std::vector<std::vector<int64_t>> output_shapes_;
+  /*! \brief Caller buffers the outputs are copied to at the end of Run(), data is nullptr for
+   *         unbound outputs.
+   */
+  std::vector<DLTensor> copy_outputs_;
+  std::vector<std::vector<int64_t>> copy_output_shapes_;
   const tvm::runtime::NDArray empty_;
   tvm::runtime::vm::AllocatorType allocator_type_;
 
@@ -61,8 +105,30 @@ class DLR_DLL RelayVMModel : public DLRModel {
   void UpdateOutputs();
   void UpdateInputs();
   DLDataType GetInputDLDataType(int index);
+  tvm::runtime::NDArray GetInputBuffer(int index, const int64_t* shape, int ndim,
+                                       DLDataType dtype);
+  /*! \brief Wrap tensor as the index-th input without copying it, returns false if tensor does
+   *         not meet the VM's requirements (alignment, device, type, shape).
+   */
+  bool SetInputZeroCopy(int index, const DLTensor* tensor);
+  /*! \brief Whether tensor can be passed to the VM as the index-th input as is. */
+  bool CanInputZeroCopy(int index, const DLTensor* tensor);
+  /*! \brief Set input padded up to the shape buckets, returns false if no dimension needed
+   *         padding.
+   */
+  bool SetInputPadded(int index, const int64_t* shape, const void* input, int dim,
+                      DLDataType dtype);
+  /*! \brief Slice dynamic output dimensions with a padded input length back to the length
+   *         given by the caller. This is a heuristic: the VM does not tell which input an output
+   *         dimension follows, so any dynamic output dimension equal to a padded length is
+   *         sliced, even if it only happens to have that length. Models where that matters
+   *         should not use ShapeBuckets.
+   */
+  void SliceOutputs();
 
  public:
+  /*! \brief Number of input buffers kept per input. */
+  static const size_t kMaxInputBuffers = 8;
   explicit RelayVMModel(const std::vector<std::string>& files, const DLDevice& dev)
       : DLRModel(dev, DLRBackend::kRELAYVM),
         allocator_type_(tvm::runtime::vm::AllocatorType::kPooled) {
@@ -89,6 +155,10 @@ class DLR_DLL RelayVMModel : public DLRModel {
   virtual void SetInput(const char* name, const int64_t* shape, const void* input,
                         int dim) override;
   void SetInputTensor(const char* name, DLTensor* tensor);
+  /*! \brief Pass tensor to the VM as input without copying it. Data must be aligned to 64 bytes,
+   *         on the model's device and stay unchanged until Run() returned.
+   */
+  void SetInputTensorZeroCopy(const char* name, DLTensor* tensor);
   virtual int GetNumInputs() const override;
   virtual void Run() override;
   tvm::runtime::NDArray GetOutput(int index);
@@ -99,9 +169,31 @@ class DLR_DLL RelayVMModel : public DLRModel {
   virtual void GetOutputSizeDim(int index, int64_t* size, int* dim) override;
   virtual const char* GetOutputType(int index) const override;
   void GetOutputTensor(int index, DLTensor* out);
+  /*! \brief Copy the index-th output into tensor at the end of every Run(). This is not zero
+   *         copy: the VM allocates output storage itself, so binding saves the separate
+   *         GetOutput call but not the copy. Like TVM's zero-copy outputs, tensor must be
+   *         aligned to kAllocAlignment and match the output's type and static dimensions, and
+   *         be on the model's device or the CPU. nullptr unbinds the output.
+   */
+  void SetOutputTensorCopy(int index, DLTensor* tensor);
+  /*! \brief Get the index-th output without copying, or an empty NDArray if the output is
+   *         produced by a data transform. The NDArray is replaced by the next Run().
+   */
+  tvm::runtime::NDArray GetOutputNDArray(int index) const;
+  /*! \brief Get the array passed to the VM as the index-th input, or an empty NDArray if the
+   *         input is produced by a data transform. It is replaced when the input is set again.
+   */
+  tvm::runtime::NDArray GetInputNDArray(int index) const;
+  /*! \brief Pass array as the index-th input of the next runs without copying it, until the
+   *         input is set again. Returns false if the array cannot be passed as is (input
+   *         transform, shape buckets, alignment, device, type or shape mismatch) and the input
+   *         must be copied.
+   */
+  bool BindInputZeroCopy(int index, const tvm::runtime::NDArray& array);
   virtual void SetNumThreads(int threads) override;
   virtual void UseCPUAffinity(bool use) override;
   tvm::runtime::vm::AllocatorType GetAllocatorType();
+  const std::vector<int64_t>& GetShapeBuckets() const { return shape_buckets_; }
 
   /*
     Following methods use metadata file to lookup input and output names.
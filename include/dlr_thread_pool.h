@@ -0,0 +1,75 @@
+#ifndef DLR_THREAD_POOL_H_
+#define DLR_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#if defined(_MSC_VER) || defined(_WIN32)
+#define DLR_DLL __declspec(dllexport)
+#else
+#define DLR_DLL
+#endif  // defined(_MSC_VER) || defined(_WIN32)
+
+namespace dlr {
+
+/*! \brief Fixed size pool of worker threads executing tasks in submission order.
+ */
+class DLR_DLL ThreadPool {
+ private:
+  std::vector<std::thread> workers_;
+  std::queue<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+
+  void WorkerLoop();
+
+ public:
+  explicit ThreadPool(int num_threads);
+  ~ThreadPool();
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int GetNumThreads() const { return static_cast<int>(workers_.size()); }
+
+  /*! \brief Queue a task. Exceptions thrown by the task are stored in the returned future. */
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> Submit(F&& f) {
+    using R = typename std::result_of<F()>::type;
+    auto task = std::make_shared<std::packaged_task<R()>>(std::forward<F>(f));
+    std::future<R> result = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      tasks_.emplace([task]() { (*task)(); });
+    }
+    cv_.notify_one();
+    return result;
+  }
+
+  /*! \brief Split [0, num_items) into contiguous ranges and call fn(begin, end) for each of them
+   *         on the pool and the calling thread. Blocks until all ranges are done and rethrows
+   *         the first exception. Must not be called from a task running on the same pool.
+   */
+  void ParallelFor(size_t num_items, const std::function<void(size_t, size_t)>& fn);
+
+  /*! \brief Process-wide pool used for asynchronous inference. Its size is read from the
+   *         DLR_NUM_ASYNC_THREADS environment variable, default is 2.
+   */
+  static ThreadPool& Global();
+
+  /*! \brief Process-wide pool used to parallelize input preparation. Its size is read from the
+   *         DLR_NUM_COMPUTE_THREADS environment variable, default is the number of hardware
+   *         threads minus one, as the calling thread takes part in ParallelFor.
+   */
+  static ThreadPool& Compute();
+};
+
+}  // namespace dlr
+
+#endif  // DLR_THREAD_POOL_H_
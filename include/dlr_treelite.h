@@ -3,6 +3,10 @@
 
 #include <treelite/c_api_runtime.h>
 
+#include <atomic>
+#include <functional>
+#include <memory>
+
 #include "dlr_allocator.h"
 #include "dlr_common.h"
 
@@ -14,6 +18,8 @@
 
 namespace dlr {
 
+class ThreadPool;
+
 /*! \brief Structure to hold Treelite Input.
  */
 struct TreeliteInput {
@@ -23,6 +29,7 @@ struct TreeliteInput {
   size_t num_row;
   size_t num_col;
   DMatrixHandle handle = nullptr;
+  void FreeHandle();
   ~TreeliteInput();
 };
 
@@ -38,6 +45,11 @@ class DLR_DLL TreeliteModel : public DLRModel {
   static const std::string INPUT_TYPE;
   static const std::string OUTPUT_TYPE;
   static const int kInputDim = 2;
+  /*! \brief Inputs with a larger fraction of missing (NaN) values are passed as CSR. */
+  static constexpr float kDenseMaxMissingRatio = 0.5f;
+  /*! \brief Inputs with fewer elements are converted to CSR on the calling thread only. */
+  static const size_t kParallelMinElements = 1 << 16;
+  static const size_t kDefaultStreamChunkRows = 4096;
   // fields for Treelite model
   PredictorHandle treelite_model_;
   size_t treelite_num_feature_;
@@ -47,10 +59,30 @@ class DLR_DLL TreeliteModel : public DLRModel {
   size_t treelite_output_size_;
   std::unique_ptr<TreeliteInput> treelite_input_;
   std::vector<float, DLRAllocator<float>> treelite_output_;
+  /*! \brief Double buffers used by PredictStream: one chunk is predicted while the next one
+   *         is being converted.
+   */
+  TreeliteInput stream_inputs_[2];
+  std::vector<float, DLRAllocator<float>> stream_outputs_[2];
+  std::vector<float, DLRAllocator<float>> stream_rows_;
+  /*! \brief Thread predicting chunks for PredictStream, created on first use. It is not taken
+   *         from the async inference pool, which streaming would otherwise starve.
+   */
+  std::unique_ptr<ThreadPool> stream_worker_;
+  /*! \brief Number of times an input or output buffer had to grow. */
+  std::atomic<size_t> num_buffer_allocations_{0};
   /*! \brief Whether input is sparse (zero values should be skipped) */
   bool has_sparse_input_;
   void SetupTreeliteModule(const std::vector<std::string>& files);
   void UpdateInputShapes();
+  void PrepareInput(const float* input, size_t batch_size, uint32_t num_col, TreeliteInput* out);
+  void PrepareInputDense(const float* input, size_t batch_size, TreeliteInput* out);
+  void PrepareInputCSR(const float* input, size_t batch_size, uint32_t num_col,
+                       TreeliteInput* out);
+  /*! \brief Predict input into output and return the number of outputs per row. */
+  size_t PredictBatch(TreeliteInput* input, std::vector<float, DLRAllocator<float>>* output);
+  void PredictChunks(const std::function<const float*(size_t* num_rows)>& next_chunk,
+                     const std::function<void(const float*, size_t, size_t)>& on_output);
 
   // whether to produce raw margin scores instead of transformed probabilities
   int pred_margin = 0;
@@ -86,6 +118,33 @@ class DLR_DLL TreeliteModel : public DLRModel {
   virtual void UseCPUAffinity(bool use) override;
 
   inline void SetPredMargin(bool pred_margin) { this->pred_margin = int(pred_margin); };
+
+  /*! \brief Get the number of times input or output buffers were (re)allocated. Buffers keep
+   *         their capacity across SetInput/Run calls, so this stays constant in a steady state
+   *         loop with constant batch size.
+   */
+  size_t GetNumBufferAllocations() const { return num_buffer_allocations_.load(); }
+
+  /*! \brief Reads up to max_rows rows of GetInputSize(0) values into rows and returns the number
+   *         of rows read, 0 at the end of the stream.
+   */
+  typedef std::function<size_t(float* rows, size_t max_rows)> RowReader;
+  /*! \brief Receives the predictions of num_rows consecutive rows, row_size values per row. */
+  typedef std::function<void(const float* output, size_t num_rows, size_t row_size)> OutputWriter;
+
+  /*! \brief Score all rows produced by next_rows in chunks of chunk_rows rows, memory use is
+   *         bounded by the chunk size. Outputs are passed to on_output in row order. Prediction
+   *         of a chunk overlaps with reading and converting the next one. Does not change the
+   *         input and output used by SetInput/Run.
+   */
+  void PredictStream(const RowReader& next_rows, const OutputWriter& on_output,
+                     size_t chunk_rows = kDefaultStreamChunkRows);
+
+  /*! \brief Score a file of row-major float32 values with GetInputSize(0) columns. The file is
+   *         memory mapped and read chunk by chunk, see PredictStream.
+   */
+  void PredictFile(const std::string& path, const OutputWriter& on_output,
+                   size_t chunk_rows = kDefaultStreamChunkRows);
 };
 
 }  // namespace dlr
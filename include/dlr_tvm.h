@@ -6,6 +6,7 @@
 #include <tvm/runtime/registry.h>
 
 #include "dlr_common.h"
+#include "dlr_param_store.h"
 
 #ifdef ENABLE_DATATRANSFORM
 #include "dlr_data_transform.h"
@@ -19,37 +20,210 @@
 
 namespace dlr {
 
+/*! \brief Weight bound to the graph executor directly from a params blob, without a copy.
+ */
+struct TVMMappedParam {
+  int input_index;
+  std::vector<int64_t> shape;
+  DLTensor tensor;
+};
+
+/*! \brief Weights of a TVMModel bound from outside its executor: aliasing the params blob
+ *         (TVM_PARAMS_MMAP), held by the ParamStore (TVM_PARAMS_SHARED) or in a shared memory
+ *         segment (TVM_PARAMS_SHM).
+ */
+struct TVMMappedParams {
+  /*! \brief Mapping of the params file or of the model archive holding the blob, nullptr when
+   *         the blob is owned by the caller.
+   */
+  std::shared_ptr<const MemoryMappedFile> file;
+  std::vector<TVMMappedParam> params;
+  /*! \brief Arrays acquired from the ParamStore, released on destruction. */
+  std::vector<tvm::runtime::NDArray> shared;
+  /*! \brief Segment the weights are read from, shared with other processes. */
+  std::unique_ptr<SharedMemorySegment> segment;
+
+  TVMMappedParams() = default;
+  TVMMappedParams(const TVMMappedParams&) = delete;
+  TVMMappedParams& operator=(const TVMMappedParams&) = delete;
+  ~TVMMappedParams();
+};
+
+/*! \brief Graph of a TVMModel for one batch size. Weights are bound to the ones of the model
+ *         and read from there. GraphExecutor::Init still allocates storage for them in each
+ *         executor, which stays allocated but unused.
+ */
+struct TVMBatchVariant {
+  int64_t batch_size;
+  std::shared_ptr<const std::string> graph_json;
+  tvm::runtime::Module lib;
+  /*! \brief Executors of the graph, chunks of a batch run on them concurrently. */
+  std::vector<tvm::runtime::ObjectPtr<tvm::runtime::GraphExecutor>> executors;
+  /*! \brief Executor input index of each model input. */
+  std::vector<int> input_indices;
+};
+
 /*! \brief class TVMModel
  */
 class DLR_DLL TVMModel : public DLRModel {
  private:
+  /*! \brief Graph JSON, shared by all execution contexts of the model. */
+  std::shared_ptr<const std::string> graph_json_;
+  /*! \brief Backing file of tvm_lib_ when TVM_LIB was given in memory, declared first to
+   *         outlive the library.
+   */
+  std::shared_ptr<InMemoryLibrary> lib_memory_;
+  /*! \brief Compiled operator library, shared by all execution contexts of the model. */
+  tvm::runtime::Module tvm_lib_;
+  /*! \brief Path tvm_lib_ was loaded from. */
+  std::string lib_path_;
   tvm::runtime::ObjectPtr<tvm::runtime::GraphExecutor> tvm_graph_executor_;
   std::shared_ptr<tvm::runtime::Module> tvm_module_;
   std::vector<tvm::runtime::NDArray> inputs_;
   std::vector<tvm::runtime::NDArray> outputs_;
   std::vector<std::string> output_types_;
   std::vector<std::string> weight_names_;
+  /*! \brief Params blob aliased by the weights, shared by all execution contexts. */
+  std::shared_ptr<TVMMappedParams> mapped_params_;
+  /*! \brief Caller data each executor input reads in place, by graph input index, nullptr if
+   *         the input uses the executor's own buffer.
+   */
+  std::vector<const void*> zero_copy_inputs_;
+  /*! \brief Prepared bindings used by RunBound: executor input arrays in input order, and host
+   *         views of inputs and outputs whose data pointer is filled in per call.
+   */
+  std::vector<tvm::runtime::NDArray> bound_inputs_;
+  std::vector<DLTensor> bound_input_views_;
+  std::vector<DLTensor> bound_output_views_;
+  /*! \brief Caller buffers bound as output storage by SetOutputTensorZeroCopy, data is nullptr
+   *         for outputs written to the executor's own buffers.
+   */
+  std::vector<DLTensor> zero_copy_outputs_;
+  /*! \brief Graphs by ascending batch size, this model's own included, when the metadata
+   *         lists "BatchVariants" or an input with another batch size than the graph's was set.
+   *         Empty otherwise.
+   */
+  std::vector<TVMBatchVariant> batch_variants_;
+  /*! \brief Executors per batch variant, from DLR_TVM_BATCH_CONTEXTS (default 1). Contexts
+   *         split TVM_NUM_THREADS between them unless TVM binds threads to cores.
+   */
+  int num_batch_contexts_ = 1;
+  /*! \brief With batch variants, SetInput keeps inputs in host buffers and Run splits them
+   *         across variants, collecting outputs of all rows in host buffers.
+   */
+  std::vector<int64_t> batch_input_rows_;
+  std::vector<std::vector<char>> batch_inputs_;
+  std::vector<std::vector<char>> batch_outputs_;
+  std::vector<std::vector<int64_t>> batch_output_shapes_;
+  /*! \brief Padding buffer of each batch context. */
+  std::vector<std::vector<char>> batch_staging_;
 
 #ifdef ENABLE_DATATRANSFORM
   DataTransform data_transform_;
 #endif
 
   void SetupTVMModule(const std::vector<std::string>& files);
-  void SetupTVMModule(const std::vector<DLRModelElem>& model_elems);
+  void SetupTVMModule(const std::vector<DLRModelElem>& model_elems,
+                      std::shared_ptr<const MemoryMappedFile> backing = nullptr);
+  void LoadParamsZeroCopy(const char* params_data, size_t params_size);
+  void LoadParamsCopy(const char* params_data, size_t params_size);
+  void LoadParamsShared(const char* params_data, size_t params_size);
+  bool LoadParamsSharedMemory(const char* params_data, size_t params_size);
+  void LoadParamsCompressed(const char* params_data, size_t params_size);
+  void BindMappedParams();
+  void FetchExecutorData();
+  bool BindGraphInputZeroCopy(int graph_index, const DLTensor* tensor);
+  void ResetGraphInputZeroCopy(int graph_index);
   void UpdateInputShapes();
+  /*! \brief Whether all inputs and outputs have the batch size of the graph as first
+   *         dimension, which batch variants require.
+   */
+  bool HasBatchDim() const;
+  void InitBatchVariants();
+  void LoadBatchVariants(const std::string& model_dir);
+  void AddBatchContexts();
+  /*! \brief Use the batch variants of base, with executors of this model. */
+  void ShareBatchVariants(const TVMModel& base);
+  void WarnIfBatchVariants();
+  tvm::runtime::ObjectPtr<tvm::runtime::GraphExecutor> CreateSharedExecutor(
+      const TVMBatchVariant& variant);
+  void RunBatchChunk(const TVMBatchVariant& variant, int context, int64_t first_row,
+                     int64_t num_rows);
+  void SetBatchInput(int index, const int64_t* shape, const void* input, int dim);
+  /*! \brief Switch to batch variants of the model's own graph, starting with this input. */
+  void EnterBatchVariants(const char* name, const int64_t* shape, const void* input, int dim);
+  /*! \brief Switch back from the model's own graph once all inputs have its batch size. */
+  void LeaveBatchVariants();
+  void RunBatchVariants();
+  bool HasBatchOutputs() const { return !batch_output_shapes_.empty(); }
+  /*! \brief Describe the index-th output if it is not held by the executor, as outputs of batch
+   *         variants and zero-copy outputs are.
+   *  \return false if the executor holds the output.
+   */
+  bool GetDetachedOutput(int index, DLTensor* tensor);
+
+  /*! \brief Create an execution context which shares module and params with base model.
+   */
+  explicit TVMModel(const TVMModel& base, const DLDevice& dev);
 
  public:
-  /*! \brief Load model files from given folder path.
+  /*! \brief Load model files from given folder path. Graphs compiled for other batch sizes
+   *         are loaded as well if the metadata lists their folders in "BatchVariants", relative
+   *         to the folder of the metadata file. Each SetInput then may have any number of rows
+   *         and Run dispatches them to the smallest variant which fits, splitting batches larger
+   *         than the largest variant across runs. Models without variants switch to the same
+   *         mode when an input's batch size differs from the graph's, and back once all inputs
+   *         have the graph's batch size again.
+   *         With DLR_TVM_PARAMS_SHM=1 the first process loading the params copies them to a
+   *         named shared memory segment (dlr_params_*, named after a hash of the file) and all
+   *         processes, this one included, read them from there. Segments persist until removed.
    */
   explicit TVMModel(const std::vector<std::string>& files, const DLDevice& dev)
       : DLRModel(dev, DLRBackend::kTVM) {
     SetupTVMModule(files);
   }
+  /*! \brief Load model elements. "BatchVariants" in the metadata are ignored, their folders
+   *         are relative to a model folder there is none of.
+   */
   explicit TVMModel(std::vector<DLRModelElem> model_elems, const DLDevice& dev)
       : DLRModel(dev, DLRBackend::kTVM) {
     SetupTVMModule(model_elems);
+    WarnIfBatchVariants();
+  }
+  /*! \brief Load model elements whose data lies in backing, e.g. the sections of a model
+   *         archive. Weights aliasing it (TVM_PARAMS_MMAP) keep the mapping alive.
+   */
+  explicit TVMModel(std::vector<DLRModelElem> model_elems, const DLDevice& dev,
+                    std::shared_ptr<const MemoryMappedFile> backing)
+      : DLRModel(dev, DLRBackend::kTVM) {
+    SetupTVMModule(model_elems, std::move(backing));
+    WarnIfBatchVariants();
   }
 
+  /*! \brief Type of the params element for loading from files, as set by DLR_TVM_PARAMS_MMAP,
+   *         DLR_TVM_PARAMS_SHM and DLR_TVM_SHARE_PARAMS.
+   */
+  static DLRModelElemType GetParamsElemType();
+
+  /*! \brief Create an execution context for this model. The context shares the loaded module
+   *         and the params NDArrays with this model, but has its own executor storage for
+   *         inputs, outputs and intermediate results. Different contexts can run concurrently.
+   *         Batch variants loaded with the model are shared the same way.
+   */
+  TVMModel* CreateExecutionContext() const;
+
+  /*! \brief Write a model archive of the graph, library, metadata and the loaded weights in
+   *         their final layout. Loading the archive with CreateDLRModelFromArchive() binds the
+   *         weights in place from the mapped file instead of copying them. The graph is still
+   *         parsed and GraphExecutor::Init still runs, allocating storage for the weights too.
+   */
+  void SaveSnapshot(const std::string& path) const;
+
+  /*! \brief Batch sizes of the graphs inputs are dispatched to, ascending. Empty unless the
+   *         model runs batch variants.
+   */
+  std::vector<int64_t> GetBatchVariantSizes() const;
+
   virtual const int GetInputDim(int index) const override;
   virtual const int64_t GetInputSize(int index) const override;
   virtual const char* GetInputName(int index) const override;
@@ -60,6 +234,13 @@ class DLR_DLL TVMModel : public DLRModel {
                         int dim) override;
   void SetInputTensor(const char* name, DLTensor* tensor);
   void SetInputTensorZeroCopy(const char* name, DLTensor* tensor);
+  /*! \brief Make the index-th input read tensor in place in later runs, until
+   *         ResetInputZeroCopy() is called. Returns false if the tensor cannot be bound (input
+   *         transform, alignment, device, type or shape mismatch) and the input must be copied.
+   */
+  bool BindInputZeroCopy(int index, const DLTensor* tensor);
+  /*! \brief Bind the index-th input back to the executor's own input buffer. */
+  void ResetInputZeroCopy(int index);
 
   virtual void GetOutput(int index, void* out) override;
   void GetOutputManagedTensorPtr(int index, const DLManagedTensor** out);
@@ -68,11 +249,38 @@ class DLR_DLL TVMModel : public DLRModel {
   virtual void GetOutputSizeDim(int index, int64_t* size, int* dim) override;
   virtual const char* GetOutputType(int index) const override;
   void GetOutputTensor(int index, DLTensor* out);
+  /*! \brief Make the executor write the index-th output directly into tensor in later runs.
+   *         GetOutput and GetOutputPtr read from tensor while it is bound. nullptr restores the
+   *         executor's own output buffer.
+   */
+  void SetOutputTensorZeroCopy(int index, DLTensor* tensor);
+  /*! \brief Get the index-th output without copying, or an empty NDArray if the output is
+   *         produced by a data transform or bound to a caller buffer. The contents change with
+   *         the next Run().
+   */
+  tvm::runtime::NDArray GetOutputNDArray(int index) const;
 
   virtual const char* GetWeightName(int index) const override;
   virtual std::vector<std::string> GetWeightNames() const override;
+  /*! \brief Data the index-th weight is read from in runs, nullptr for weights which are not
+   *         in the graph.
+   */
+  const void* GetWeightData(int index) const;
+  /*! \brief Mapping the weights are bound from in place, nullptr unless they alias a file. */
+  const MemoryMappedFile* GetParamsMapping() const;
 
   virtual void Run() override;
+
+  /*! \brief Resolve inputs and outputs once for RunBound(). Shapes are fixed to the current input
+   *         shapes. Not supported with data transforms.
+   */
+  void PrepareBindings();
+  /*! \brief Copy inputs in, run and copy outputs out without name lookups or allocations.
+   *  \param inputs One host buffer per input, in input index order.
+   *  \param outputs One host buffer per output, in output index order.
+   */
+  void RunBound(const void* const* inputs, void* const* outputs);
+
   virtual void SetNumThreads(int threads) override;
   virtual void UseCPUAffinity(bool use) override;
 
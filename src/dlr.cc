@@ -1,6 +1,10 @@
 #include "dlr.h"
 
+#include "dlr_allocator.h"
+#include "dlr_archive.h"
+#include "dlr_batcher.h"
 #include "dlr_common.h"
+#include "dlr_param_store.h"
 #include "dlr_pipeline.h"
 #include "dlr_relayvm.h"
 #include "dlr_treelite.h"
@@ -14,7 +18,10 @@
 #include "dlr_hexagon/dlr_hexagon.h"
 #endif  // DLR_HEXAGON
 
+#include <cstring>
+#include <fstream>
 #include <locale>
+#include <numeric>
 
 using namespace dlr;
 
@@ -111,15 +118,37 @@ extern "C" int SetDLRInputTensor(DLRModelHandle* handle, const char* name, void*
 extern "C" int SetDLRInputTensorZeroCopy(DLRModelHandle* handle, const char* name, void* tensor) {
   API_BEGIN();
   DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
   DLRBackend backend = dlr_model->GetBackend();
-  CHECK(backend == DLRBackend::kTVM)
-      << "model is not a TVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
-      << "' but expected 'tvm'";
+  CHECK(backend == DLRBackend::kTVM || backend == DLRBackend::kRELAYVM)
+      << "model is not a TVMModel or RelayVMModel. Found '"
+      << kBackendToStr[static_cast<int>(backend)] << "' but expected 'tvm' or 'relayvm'";
+
+  DLTensor* dltensor = static_cast<DLTensor*>(tensor);
+  if (backend == DLRBackend::kTVM) {
+    static_cast<TVMModel*>(dlr_model)->SetInputTensorZeroCopy(name, dltensor);
+  } else {
+    static_cast<RelayVMModel*>(dlr_model)->SetInputTensorZeroCopy(name, dltensor);
+  }
+  API_END();
+}
+
+extern "C" int SetDLROutputTensorZeroCopy(DLRModelHandle* handle, int index, void* tensor) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTVM || backend == DLRBackend::kRELAYVM)
+      << "model is not a TVMModel or RelayVMModel. Found '"
+      << kBackendToStr[static_cast<int>(backend)] << "' but expected 'tvm' or 'relayvm'";
 
   DLTensor* dltensor = static_cast<DLTensor*>(tensor);
-  TVMModel* tvm_model = static_cast<TVMModel*>(*handle);
-  CHECK(tvm_model != nullptr) << "model is nullptr, create it first";
-  tvm_model->SetInputTensorZeroCopy(name, dltensor);
+  if (backend == DLRBackend::kTVM) {
+    static_cast<TVMModel*>(dlr_model)->SetOutputTensorZeroCopy(index, dltensor);
+  } else {
+    // The VM allocates its outputs, they are copied into the tensor after each run.
+    static_cast<RelayVMModel*>(dlr_model)->SetOutputTensorCopy(index, dltensor);
+  }
   API_END();
 }
 
@@ -423,6 +452,83 @@ extern "C" int CreateDLRModelFromModelElem(DLRModelHandle* handle, const DLRMode
   API_END();
 }
 
+extern "C" int CreateDLRModelFromArchive(DLRModelHandle* handle, const char* archive_path,
+                                         int dev_type, int dev_id) {
+  API_BEGIN();
+  DLDevice dev;
+  dev.device_type = static_cast<DLDeviceType>(dev_type);
+  dev.device_id = dev_id;
+
+  ModelArchive archive(archive_path);
+  std::vector<DLRModelElem> model_elems;
+  for (const DLRModelElem& el : archive.GetElems()) {
+    // Params are loaded as they would be from a model folder.
+    const DLRModelElemType type =
+        el.type == DLRModelElemType::TVM_PARAMS ? TVMModel::GetParamsElemType() : el.type;
+    model_elems.push_back({type, el.path, el.data, el.data_size});
+  }
+  DLRBackend backend = dlr::GetBackend(model_elems);
+  DLRModel* model;
+  if (backend == DLRBackend::kTVM) {
+    model = new TVMModel(model_elems, dev, archive.GetFile());
+  } else if (backend == DLRBackend::kRELAYVM) {
+    model = new RelayVMModel(model_elems, dev);
+  } else {
+    throw dmlc::Error(std::string("Unsupported backend in model archive: ") + archive_path);
+  }
+  *handle = model;
+  API_END();
+}
+
+extern "C" int PackDLRModel(const char* model_path, const char* archive_path) {
+  API_BEGIN();
+  ModelArchive::Pack(FindFiles(dlr::MakePathVec(model_path)), archive_path);
+  API_END();
+}
+
+extern "C" int CompressDLRParams(const char* params_path, const char* out_path, int level) {
+  API_BEGIN();
+  MemoryMappedFile params(params_path);
+  const std::string compressed = CompressParams(params.GetData(), params.GetSize(), level);
+  std::ofstream out(out_path, std::ios::out | std::ios::binary | std::ios::trunc);
+  out.write(compressed.data(), compressed.size());
+  out.close();
+  if (!out) throw dmlc::Error(std::string("Unable to write compressed params: ") + out_path);
+  API_END();
+}
+
+extern "C" int SaveDLRModelSnapshot(DLRModelHandle* handle, const char* path) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTVM)
+      << "model is not a TVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'tvm'";
+  static_cast<TVMModel*>(dlr_model)->SaveSnapshot(path);
+  API_END();
+}
+
+extern "C" int GetDLRNumLoadPhases(DLRModelHandle* handle, int* num_phases) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  *num_phases = static_cast<int>(model->GetLoadPhases().size());
+  API_END();
+}
+
+extern "C" int GetDLRLoadPhase(DLRModelHandle* handle, int index, const char** name, double* ms) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  const auto& phases = model->GetLoadPhases();
+  CHECK(index >= 0 && index < static_cast<int>(phases.size()))
+      << "Load phase index out of range: " << index;
+  *name = phases[index].first.c_str();
+  *ms = phases[index].second;
+  API_END();
+}
+
 /*! \brief Translate c args from ctypes to std types for DLRModel ctor.
  */
 extern "C" int CreateDLRPipeline(DLRModelHandle* handle, int num_models, const char** model_paths,
@@ -446,6 +552,19 @@ extern "C" int CreateDLRPipeline(DLRModelHandle* handle, int num_models, const c
   API_END();
 }
 
+extern "C" int CreateDLRExecutionContext(DLRModelHandle* handle, DLRModelHandle* context) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTVM)
+      << "model is not a TVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'tvm'";
+  TVMModel* tvm_model = static_cast<TVMModel*>(dlr_model);
+  *context = tvm_model->CreateExecutionContext();
+  API_END();
+}
+
 extern "C" int DeleteDLRModel(DLRModelHandle* handle) {
   API_BEGIN();
   DLRModel* model = static_cast<DLRModel*>(*handle);
@@ -460,6 +579,180 @@ extern "C" int RunDLRModel(DLRModelHandle* handle) {
   API_END();
 }
 
+extern "C" int CreateDLRBatcher(DLRModelHandle* handle, int max_batch, int64_t max_delay_us,
+                                DLRBatcherHandle* batcher) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  *batcher = new DLRBatcher(model, max_batch, max_delay_us);
+  API_END();
+}
+
+extern "C" int SubmitDLRRequest(DLRBatcherHandle* batcher, int64_t num_rows, const void** inputs,
+                                void** outputs) {
+  API_BEGIN();
+  DLRBatcher* dlr_batcher = static_cast<DLRBatcher*>(*batcher);
+  CHECK(dlr_batcher != nullptr) << "batcher is nullptr, create it first";
+  dlr_batcher->Submit(num_rows, inputs, outputs);
+  API_END();
+}
+
+extern "C" int DeleteDLRBatcher(DLRBatcherHandle* batcher) {
+  API_BEGIN();
+  DLRBatcher* dlr_batcher = static_cast<DLRBatcher*>(*batcher);
+  delete dlr_batcher;
+  *batcher = NULL;
+  API_END();
+}
+
+extern "C" int PrepareDLRBindings(DLRModelHandle* handle) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTVM)
+      << "model is not a TVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'tvm'";
+  static_cast<TVMModel*>(dlr_model)->PrepareBindings();
+  API_END();
+}
+
+extern "C" int RunDLRModelBound(DLRModelHandle* handle, const void** inputs, void** outputs) {
+  API_BEGIN();
+  DLRModel* dlr_model = static_cast<DLRModel*>(*handle);
+  CHECK(dlr_model != nullptr) << "model is nullptr, create it first";
+  DLRBackend backend = dlr_model->GetBackend();
+  CHECK(backend == DLRBackend::kTVM)
+      << "model is not a TVMModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'tvm'";
+  static_cast<TVMModel*>(dlr_model)->RunBound(inputs, outputs);
+  API_END();
+}
+
+extern "C" int AllocDLRInputBuffer(DLRModelHandle* handle, const char* name, void** buffer) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  CHECK(model->GetDevice().device_type == kDLCPU)
+      << "AllocDLRInputBuffer is only supported for models on CPU.";
+  int index = -1;
+  for (int i = 0; i < model->GetNumInputs(); i++) {
+    if (std::strcmp(model->GetInputName(i), name) == 0) index = i;
+  }
+  CHECK_GE(index, 0) << "Input " << name << " not found.";
+  const std::vector<int64_t>& shape = model->GetInputShape(index);
+  CHECK(!HasNegative(shape.data(), shape.size()))
+      << "Input " << name << " has a dynamic shape, buffer size is unknown.";
+  const size_t num_elements =
+      std::accumulate(shape.begin(), shape.end(), int64_t{1}, std::multiplies<int64_t>());
+  *buffer =
+      DLRBufferPool::Global().Alloc(num_elements * GetDataTypeBytes(model->GetInputType(index)));
+  API_END();
+}
+
+extern "C" int FreeDLRBuffer(void* buffer) {
+  API_BEGIN();
+  DLRBufferPool::Global().Free(buffer);
+  API_END();
+}
+
+extern "C" int GetDLRRelayVMPoolStats(size_t* bytes_cached, size_t* bytes_in_use,
+                                      float* hit_rate) {
+  API_BEGIN();
+  DLRBufferPoolStats stats = DLRBufferPool::RelayVM().GetStats();
+  *bytes_cached = stats.bytes_cached;
+  *bytes_in_use = stats.bytes_in_use;
+  const size_t num_allocs = stats.num_hits + stats.num_misses;
+  *hit_rate = num_allocs > 0 ? static_cast<float>(stats.num_hits) / num_allocs : 0.0f;
+  API_END();
+}
+
+extern "C" int SetDLRRelayVMPoolLimit(size_t max_cached_bytes) {
+  API_BEGIN();
+  DLRBufferPool::RelayVM().SetMaxCachedBytes(max_cached_bytes);
+  API_END();
+}
+
+extern "C" int TrimDLRRelayVMPool() {
+  API_BEGIN();
+  DLRBufferPool::RelayVM().Trim();
+  API_END();
+}
+
+extern "C" int GetDLRParamStoreStats(size_t* stored_bytes, size_t* deduplicated_bytes) {
+  API_BEGIN();
+  ParamStoreStats stats = ParamStore::Global().GetStats();
+  *stored_bytes = stats.stored_bytes;
+  *deduplicated_bytes = stats.deduplicated_bytes;
+  API_END();
+}
+
+extern "C" int RemoveDLRSharedParams(const char* model_path) {
+  API_BEGIN();
+  ModelPath path;
+  InitModelPath(FindFiles(dlr::MakePathVec(model_path)), &path);
+  if (!path.params.empty()) {
+    MemoryMappedFile params(path.params);
+    SharedMemorySegment::Remove(GetSharedParamsName(params.GetData(), params.GetSize()));
+  } else {
+    ModelArchive archive(model_path);
+    for (const DLRModelElem& el : archive.GetElems()) {
+      if (el.type != DLRModelElemType::TVM_PARAMS) continue;
+      SharedMemorySegment::Remove(
+          GetSharedParamsName(static_cast<const char*>(el.data), el.data_size));
+    }
+  }
+  API_END();
+}
+
+/*! \brief Store the error for the calling thread and turn it into a C API status. */
+static int ErrorToStatus(std::exception_ptr error, const char* api_name) {
+  if (!error) return 0;
+  try {
+    std::rethrow_exception(error);
+  } catch (std::exception& e) {
+    // Error is stored for the worker thread, the callback can read it via DLRGetLastError().
+    TVMAPISetLastError(e.what());
+  } catch (...) {
+    TVMAPISetLastError((std::string("Unknown error in ") + api_name).c_str());
+  }
+  return -1;
+}
+
+extern "C" int RunDLRModelAsync(DLRModelHandle* handle, DLRRunCallback callback,
+                                void* user_data) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  CHECK(callback != nullptr) << "callback is nullptr";
+  model->RunAsync([callback, user_data](std::exception_ptr error) {
+    callback(ErrorToStatus(error, "RunDLRModelAsync"), user_data);
+  });
+  API_END();
+}
+
+extern "C" int RunDLRPipelineAsync(DLRModelHandle* handle, const void** inputs, void** outputs,
+                                   DLRRunCallback callback, void* user_data) {
+  API_BEGIN();
+  DLRModel* model = static_cast<DLRModel*>(*handle);
+  CHECK(model != nullptr) << "model is nullptr, create it first";
+  CHECK(callback != nullptr) << "callback is nullptr";
+  DLRBackend backend = model->GetBackend();
+  CHECK(backend == DLRBackend::kPIPELINE)
+      << "model is not a PipelineModel. Found '" << kBackendToStr[static_cast<int>(backend)]
+      << "' but expected 'pipeline'";
+  PipelineModel* pipeline_model = static_cast<PipelineModel*>(model);
+  for (int i = 0; i < pipeline_model->GetNumInputs(); i++) {
+    CHECK(!HasNegative(pipeline_model->GetInputShape(i).data(), pipeline_model->GetInputDim(i)))
+        << "Input #" << i << " has a dynamic shape, use PipelineModel::RunPipelined instead";
+  }
+  pipeline_model->RunPipelined(inputs, nullptr, outputs,
+                               [callback, user_data](std::exception_ptr error) {
+                                 callback(ErrorToStatus(error, "RunDLRPipelineAsync"), user_data);
+                               });
+  API_END();
+}
+
 extern "C" const char* DLRGetLastError() { return TVMGetLastError(); }
 
 extern "C" int GetDLRBackend(DLRModelHandle* handle, const char** name) {
@@ -507,18 +800,27 @@ extern "C" int UseDLRCPUAffinity(DLRModelHandle* handle, int use) {
 
 extern "C" int SetDLRCustomAllocatorMalloc(DLRMallocFunctionPtr custom_malloc_fn) {
   API_BEGIN();
+  CHECK(!DLRBufferPool::IsRelayVMHookInstalled())
+      << "Custom allocator functions cannot be set after a RelayVM model using the DLR pool "
+         "was loaded.";
   DLRAllocatorFunctions::SetMallocFunction(custom_malloc_fn);
   API_END();
 }
 
 extern "C" int SetDLRCustomAllocatorFree(DLRFreeFunctionPtr custom_free_fn) {
   API_BEGIN();
+  CHECK(!DLRBufferPool::IsRelayVMHookInstalled())
+      << "Custom allocator functions cannot be set after a RelayVM model using the DLR pool "
+         "was loaded.";
   DLRAllocatorFunctions::SetFreeFunction(custom_free_fn);
   API_END();
 }
 
 extern "C" int SetDLRCustomAllocatorMemalign(DLRMemalignFunctionPtr custom_memalign_fn) {
   API_BEGIN();
+  CHECK(!DLRBufferPool::IsRelayVMHookInstalled())
+      << "Custom allocator functions cannot be set after a RelayVM model using the DLR pool "
+         "was loaded.";
   DLRAllocatorFunctions::SetMemalignFunction(custom_memalign_fn);
   API_END();
 }
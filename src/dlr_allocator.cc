@@ -1,6 +1,12 @@
 #include "dlr_allocator.h"
 
+#include <dmlc/logging.h>
+
+#include <algorithm>
 #include <cstdlib>
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 namespace dlr {
 
@@ -50,4 +56,154 @@ void DLRAllocatorFunctions::Free(void* ptr) {
   }
 }
 
+void* DLRAllocatorFunctions::Memalign(size_t alignment, size_t size, DLRFreeFunctionPtr* free_fn) {
+  // Read both once, they may be changed concurrently.
+  DLRMemalignFunctionPtr memalign_fn = memalign_fn_;
+  DLRFreeFunctionPtr custom_free_fn = free_fn_;
+  if (memalign_fn && custom_free_fn) {
+    *free_fn = custom_free_fn;
+    return (*memalign_fn)(alignment, size);
+  }
+  *free_fn = &SystemAlignedFree;
+  return SystemMemalign(alignment, size);
+}
+
+void* DLRAllocatorFunctions::SystemMemalign(size_t alignment, size_t size) {
+#ifdef _WIN32
+  return _aligned_malloc(size, alignment);
+#else
+  void* ptr = nullptr;
+  return posix_memalign(&ptr, alignment, size) == 0 ? ptr : nullptr;
+#endif
+}
+
+void DLRAllocatorFunctions::SystemAlignedFree(void* ptr) {
+#ifdef _WIN32
+  _aligned_free(ptr);
+#else
+  free(ptr);
+#endif
+}
+
+DLRBufferPool::~DLRBufferPool() { Trim(); }
+
+size_t DLRBufferPool::SizeClass(size_t size) {
+  size_t power = kAlignment;
+  while (power < size) power <<= 1;
+  // size is in (power / 2, power], round it up to a multiple of power / 8.
+  const size_t step = std::max(kAlignment, power / 8);
+  return (std::max(size, size_t{1}) + step - 1) / step * step;
+}
+
+void* DLRBufferPool::Alloc(size_t size) {
+  const size_t size_class = SizeClass(size);
+  std::lock_guard<std::mutex> lock(mutex_);
+  Block block;
+  auto it = free_.find(size_class);
+  if (it != free_.end()) {
+    block = it->second;
+    free_.erase(it);
+    stats_.bytes_cached -= size_class;
+    stats_.num_hits++;
+  } else {
+    block.size_class = size_class;
+    block.ptr = DLRAllocatorFunctions::Memalign(kAlignment, size_class, &block.free_fn);
+    if (block.ptr == nullptr) {
+      // Cached buffers of other classes may be what stands in the way.
+      ReleaseCached(0);
+      block.ptr = DLRAllocatorFunctions::Memalign(kAlignment, size_class, &block.free_fn);
+    }
+    if (block.ptr == nullptr) {
+      throw dmlc::Error("Unable to allocate buffer of " + std::to_string(size) + " bytes.");
+    }
+    stats_.num_misses++;
+  }
+  in_use_[block.ptr] = block;
+  stats_.bytes_in_use += size_class;
+  return block.ptr;
+}
+
+void DLRBufferPool::Free(void* ptr) {
+  if (!Release(ptr)) throw dmlc::Error("Buffer was not allocated by DLR or already freed.");
+}
+
+bool DLRBufferPool::Release(void* ptr) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = in_use_.find(ptr);
+  if (it == in_use_.end()) return false;
+  const Block block = it->second;
+  in_use_.erase(it);
+  stats_.bytes_in_use -= block.size_class;
+  if (block.size_class > max_cached_bytes_ - std::min(max_cached_bytes_, stats_.bytes_cached)) {
+    (*block.free_fn)(block.ptr);
+  } else {
+    free_.emplace(block.size_class, block);
+    stats_.bytes_cached += block.size_class;
+  }
+  return true;
+}
+
+bool DLRBufferPool::Contains(const void* ptr) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return in_use_.count(const_cast<void*>(ptr)) > 0;
+}
+
+void DLRBufferPool::ReleaseCached(size_t max_bytes) {
+  for (auto it = free_.begin(); it != free_.end() && stats_.bytes_cached > max_bytes;) {
+    (*it->second.free_fn)(it->second.ptr);
+    stats_.bytes_cached -= it->first;
+    it = free_.erase(it);
+  }
+}
+
+void DLRBufferPool::Trim() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  ReleaseCached(0);
+}
+
+void DLRBufferPool::SetMaxCachedBytes(size_t max_cached_bytes) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  max_cached_bytes_ = max_cached_bytes;
+  ReleaseCached(max_cached_bytes);
+}
+
+DLRBufferPoolStats DLRBufferPool::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+DLRBufferPool& DLRBufferPool::Global() {
+  static DLRBufferPool pool;
+  return pool;
+}
+
+DLRBufferPool& DLRBufferPool::RelayVM() {
+  // Never destroyed, TVM may free buffers from static destructors after this pool would be gone.
+  static DLRBufferPool* pool = []() {
+    DLRBufferPool* pool = new DLRBufferPool();
+    pool->SetMaxCachedBytes(kRelayVMMaxCachedBytes);
+    return pool;
+  }();
+  return *pool;
+}
+
+std::atomic<bool> DLRBufferPool::relay_vm_hook_installed_{false};
+
+void DLRBufferPool::SetRelayVMHookInstalled() { relay_vm_hook_installed_ = true; }
+
+bool DLRBufferPool::IsRelayVMHookInstalled() { return relay_vm_hook_installed_; }
+
+void* DLRBufferPool::RelayVMMemalign(size_t alignment, size_t size) {
+  if (alignment > kAlignment) return DLRAllocatorFunctions::SystemMemalign(alignment, size);
+  try {
+    return RelayVM().Alloc(size);
+  } catch (const dmlc::Error&) {
+    return nullptr;
+  }
+}
+
+void DLRBufferPool::RelayVMFree(void* ptr) {
+  if (ptr != nullptr && !RelayVM().Release(ptr)) DLRAllocatorFunctions::SystemAlignedFree(ptr);
+}
+
 }  // namespace dlr
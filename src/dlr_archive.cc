@@ -0,0 +1,106 @@
+#include "dlr_archive.h"
+
+#include <dmlc/endian.h>
+
+#include <cstring>
+#include <fstream>
+
+using namespace dlr;
+
+namespace {
+
+uint64_t AlignUp(uint64_t value) {
+  return (value + kModelArchiveAlignment - 1) / kModelArchiveAlignment * kModelArchiveAlignment;
+}
+
+}  // namespace
+
+ModelArchive::ModelArchive(const std::string& path) {
+  CHECK(DMLC_IO_NO_ENDIAN_SWAP) << "Model archives are not supported on big endian platforms.";
+  file_ = std::make_shared<const MemoryMappedFile>(path);
+  const char* data = file_->GetData();
+  const uint64_t size = file_->GetSize();
+  ModelArchiveHeader header;
+  if (size < sizeof(header)) {
+    throw dmlc::Error("Invalid model archive: " + path);
+  }
+  std::memcpy(&header, data, sizeof(header));
+  if (std::memcmp(header.magic, kModelArchiveMagic, sizeof(header.magic)) != 0) {
+    throw dmlc::Error("Invalid model archive: " + path);
+  }
+  if (header.version != kModelArchiveVersion) {
+    throw dmlc::Error("Unsupported model archive version " + std::to_string(header.version) +
+                      ": " + path);
+  }
+  if (size < sizeof(header) + header.num_sections * sizeof(ModelArchiveSection)) {
+    throw dmlc::Error("Invalid model archive: " + path);
+  }
+  for (uint32_t i = 0; i < header.num_sections; i++) {
+    ModelArchiveSection section;
+    std::memcpy(&section, data + sizeof(header) + i * sizeof(section), sizeof(section));
+    if (section.offset > size || section.size > size - section.offset) {
+      throw dmlc::Error("Invalid model archive section " + std::to_string(i) + ": " + path);
+    }
+    elems_.push_back({static_cast<DLRModelElemType>(section.type), nullptr,
+                      data + section.offset, section.size});
+  }
+}
+
+void ModelArchive::Pack(const std::vector<std::string>& files, const std::string& archive_path) {
+  CHECK(DMLC_IO_NO_ENDIAN_SWAP) << "Model archives are not supported on big endian platforms.";
+  const DLRBackend backend = GetBackend(files);
+  if (backend != DLRBackend::kTVM && backend != DLRBackend::kRELAYVM) {
+    throw dmlc::Error("Only TVM and RelayVM models can be packed.");
+  }
+  ModelPath path;
+  InitModelPath(files, &path);
+  std::vector<std::pair<DLRModelElemType, std::string>> inputs;
+  if (backend == DLRBackend::kTVM) {
+    inputs = {{DLRModelElemType::TVM_GRAPH, path.model_json},
+              {DLRModelElemType::TVM_PARAMS, path.params}};
+  } else {
+    inputs = {{DLRModelElemType::RELAY_EXEC, path.relay_executable}};
+  }
+  inputs.push_back({DLRModelElemType::TVM_LIB, path.model_lib});
+  if (!path.metadata.empty()) {
+    inputs.push_back({DLRModelElemType::NEO_METADATA, path.metadata});
+  }
+
+  std::vector<std::pair<DLRModelElemType, std::string>> sections;
+  for (const auto& input : inputs) {
+    if (input.second.empty()) {
+      throw dmlc::Error("Invalid model artifact, missing a file to pack.");
+    }
+    sections.push_back(
+        {input.first, LoadFileToString(input.second, std::ios::in | std::ios::binary)});
+  }
+  Write(sections, archive_path);
+}
+
+void ModelArchive::Write(const std::vector<std::pair<DLRModelElemType, std::string>>& contents,
+                         const std::string& archive_path) {
+  std::vector<ModelArchiveSection> sections;
+  uint64_t offset =
+      AlignUp(sizeof(ModelArchiveHeader) + contents.size() * sizeof(ModelArchiveSection));
+  for (const auto& content : contents) {
+    sections.push_back({static_cast<uint32_t>(content.first), 0, offset, content.second.size()});
+    offset = AlignUp(offset + content.second.size());
+  }
+
+  std::ofstream out(archive_path, std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!out) throw dmlc::Error("Unable to open file: " + archive_path);
+  ModelArchiveHeader header;
+  std::memcpy(header.magic, kModelArchiveMagic, sizeof(header.magic));
+  header.version = kModelArchiveVersion;
+  header.num_sections = static_cast<uint32_t>(sections.size());
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(sections.data()),
+            sections.size() * sizeof(ModelArchiveSection));
+  for (size_t i = 0; i < sections.size(); i++) {
+    const uint64_t padding = sections[i].offset - static_cast<uint64_t>(out.tellp());
+    out.write(std::string(padding, '\0').data(), padding);
+    out.write(contents[i].second.data(), contents[i].second.size());
+  }
+  out.close();
+  if (!out) throw dmlc::Error("Unable to write model archive: " + archive_path);
+}
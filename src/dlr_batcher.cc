@@ -0,0 +1,182 @@
+#include "dlr_batcher.h"
+
+#include <cstring>
+#include <numeric>
+
+using namespace dlr;
+
+DLRBatcher::DLRBatcher(DLRModel* model, int64_t max_batch, int64_t max_delay_us)
+    : model_(model), max_batch_(max_batch), max_delay_(max_delay_us) {
+  CHECK(model_ != nullptr) << "model is nullptr, create it first";
+  CHECK_GT(max_batch_, 0) << "max_batch must be positive";
+  CHECK_GE(max_delay_us, 0) << "max_delay_us must not be negative";
+  const DLRBackend backend = model_->GetBackend();
+  CHECK(backend == DLRBackend::kTVM || backend == DLRBackend::kRELAYVM ||
+        backend == DLRBackend::kTREELITE)
+      << "Batching is not supported for '" << kBackendToStr[static_cast<int>(backend)]
+      << "' models";
+
+  const int num_inputs = model_->GetNumInputs();
+  for (int i = 0; i < num_inputs; i++) {
+    const std::vector<int64_t>& shape = model_->GetInputShape(i);
+    CHECK_GE(shape.size(), 1) << "Input #" << i << " has no batch dimension";
+    // Treelite reports the batch size of the last input, any number of rows is accepted.
+    if (backend != DLRBackend::kTREELITE && shape[0] > 0) {
+      CHECK(fixed_batch_ < 0 || fixed_batch_ == shape[0])
+          << "All inputs must have the same batch dimension";
+      fixed_batch_ = shape[0];
+    }
+    CHECK(!dlr::HasNegative(shape.data() + 1, shape.size() - 1))
+        << "Input #" << i << " must have a static shape apart from the batch dimension";
+    const int64_t row_size =
+        std::accumulate(shape.begin() + 1, shape.end(), 1, std::multiplies<int64_t>());
+    input_names_.push_back(model_->GetInputName(i));
+    input_shapes_.push_back(shape);
+    input_row_bytes_.push_back(row_size * dlr::GetDataTypeBytes(model_->GetInputType(i)));
+  }
+  if (fixed_batch_ > 0 && max_batch_ > fixed_batch_) {
+    LOG(WARNING) << "max_batch " << max_batch_ << " exceeds the compiled batch size of the model. "
+                 << "Using " << fixed_batch_ << " instead.";
+    max_batch_ = fixed_batch_;
+  }
+  const int num_outputs = model_->GetNumOutputs();
+  for (int i = 0; i < num_outputs; i++) {
+    output_type_bytes_.push_back(dlr::GetDataTypeBytes(model_->GetOutputType(i)));
+  }
+  input_buffers_.resize(num_inputs);
+  output_buffers_.resize(num_outputs);
+  worker_ = std::thread(&DLRBatcher::WorkerLoop, this);
+}
+
+DLRBatcher::~DLRBatcher() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  queue_cv_.notify_all();
+  worker_.join();
+  // Requests have all been failed by now, wait for their callers to wake up and leave.
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_cv_.wait(lock, [this] { return num_waiting_ == 0; });
+}
+
+void DLRBatcher::Submit(int64_t num_rows, const void* const* inputs, void* const* outputs) {
+  CHECK_GT(num_rows, 0) << "Request must have at least one row";
+  CHECK_LE(num_rows, max_batch_) << "Request has more rows than max_batch";
+  DLRBatchRequest request;
+  request.num_rows = num_rows;
+  request.inputs = inputs;
+  request.outputs = outputs;
+  request.submit_time = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(mutex_);
+  CHECK(!stop_) << "DLRBatcher is being deleted";
+  queue_.push_back(&request);
+  queued_rows_ += num_rows;
+  num_waiting_++;
+  queue_cv_.notify_all();
+  done_cv_.wait(lock, [&request] { return request.done; });
+  // The last caller to leave lets the destructor go on.
+  if (--num_waiting_ == 0 && stop_) done_cv_.notify_all();
+  lock.unlock();
+  if (request.error) {
+    std::rethrow_exception(request.error);
+  }
+}
+
+int64_t DLRBatcher::GetNumRuns() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return num_runs_;
+}
+
+void DLRBatcher::WorkerLoop() {
+  std::vector<DLRBatchRequest*> batch;
+  while (true) {
+    int64_t num_rows = 0;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      queue_cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (stop_) break;
+      // Keep collecting until the batch is full or the oldest request has waited long enough.
+      const auto deadline = queue_.front()->submit_time + max_delay_;
+      queue_cv_.wait_until(lock, deadline, [this] { return stop_ || queued_rows_ >= max_batch_; });
+      if (stop_) break;
+      batch.clear();
+      while (!queue_.empty() && num_rows + queue_.front()->num_rows <= max_batch_) {
+        batch.push_back(queue_.front());
+        num_rows += queue_.front()->num_rows;
+        queued_rows_ -= queue_.front()->num_rows;
+        queue_.pop_front();
+      }
+    }
+    // Any error, std::bad_alloc included, fails the requests of the batch instead of
+    // escaping the worker thread.
+    std::exception_ptr error;
+    try {
+      RunBatch(batch, num_rows);
+    } catch (...) {
+      error = std::current_exception();
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      num_runs_++;
+      for (DLRBatchRequest* request : batch) {
+        request->error = error;
+        request->done = true;
+      }
+    }
+    done_cv_.notify_all();
+  }
+  // Fail requests which were still waiting when the batcher was destroyed.
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (DLRBatchRequest* request : queue_) {
+    request->error = std::make_exception_ptr(
+        dmlc::Error("DLRBatcher was deleted before the request was processed"));
+    request->done = true;
+  }
+  queue_.clear();
+  queued_rows_ = 0;
+  done_cv_.notify_all();
+}
+
+void DLRBatcher::RunBatch(const std::vector<DLRBatchRequest*>& batch, int64_t num_rows) {
+  // Static batch models always run the compiled batch size, the tail is zero padded.
+  const int64_t run_rows = fixed_batch_ > 0 ? fixed_batch_ : num_rows;
+  for (size_t i = 0; i < input_names_.size(); i++) {
+    auto& buffer = input_buffers_[i];
+    const size_t row_bytes = input_row_bytes_[i];
+    buffer.resize(run_rows * row_bytes);
+    size_t offset = 0;
+    for (const DLRBatchRequest* request : batch) {
+      const size_t bytes = request->num_rows * row_bytes;
+      std::memcpy(buffer.data() + offset, request->inputs[i], bytes);
+      offset += bytes;
+    }
+    if (offset < buffer.size()) {
+      std::memset(buffer.data() + offset, 0, buffer.size() - offset);
+    }
+    input_shapes_[i][0] = run_rows;
+    model_->SetInput(input_names_[i].c_str(), input_shapes_[i].data(), buffer.data(),
+                     input_shapes_[i].size());
+  }
+
+  model_->Run();
+
+  for (size_t i = 0; i < output_buffers_.size(); i++) {
+    int64_t size;
+    int dim;
+    model_->GetOutputSizeDim(i, &size, &dim);
+    std::vector<int64_t> shape(dim);
+    model_->GetOutputShape(i, shape.data());
+    CHECK(dim > 0 && shape[0] == run_rows) << "Output #" << i << " is not batch-major";
+    auto& buffer = output_buffers_[i];
+    buffer.resize(size * output_type_bytes_[i]);
+    model_->GetOutput(i, buffer.data());
+    const size_t row_bytes = size / run_rows * output_type_bytes_[i];
+    size_t offset = 0;
+    for (const DLRBatchRequest* request : batch) {
+      const size_t bytes = request->num_rows * row_bytes;
+      std::memcpy(request->outputs[i], buffer.data() + offset, bytes);
+      offset += bytes;
+    }
+  }
+}
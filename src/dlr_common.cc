@@ -2,9 +2,23 @@
 
 #include <dmlc/filesystem.h>
 
+#include "dlr_thread_pool.h"
+
 #include <fstream>
 #include <locale>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif  // _WIN32
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif  // __linux__
+
 using namespace dlr;
 
 const char* dlr::kBackendToStr[] = {"tvm",      "treelite", "hexagon",   "relayvm",
@@ -102,6 +116,80 @@ std::string dlr::LoadFileToString(const std::string& path, std::ios_base::openmo
   return blob.str();
 }
 
+MemoryMappedFile::MemoryMappedFile(const std::string& path) {
+#ifdef _WIN32
+  buffer_ = LoadFileToString(path, std::ios::in | std::ios::binary);
+  data_ = buffer_.data();
+  size_ = buffer_.size();
+#else
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw dmlc::Error("Unable to open file: " + path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw dmlc::Error("Unable to stat file: " + path);
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ > 0) {
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      throw dmlc::Error("Unable to map file: " + path);
+    }
+    data_ = static_cast<const char*>(addr);
+  }
+  // The mapping stays valid after the descriptor is closed.
+  close(fd);
+#endif  // _WIN32
+}
+
+MemoryMappedFile::~MemoryMappedFile() {
+#ifndef _WIN32
+  if (data_ != nullptr) munmap(const_cast<char*>(data_), size_);
+#endif  // _WIN32
+  data_ = nullptr;
+}
+
+InMemoryLibrary::InMemoryLibrary(const void* data, size_t size) {
+#ifdef _WIN32
+  throw dmlc::Error("Loading a shared library from memory is not supported on this platform.");
+#else
+#if defined(__linux__) && defined(SYS_memfd_create)
+  // Called through syscall() as older C libraries lack the wrapper. 1 is MFD_CLOEXEC.
+  fd_ = static_cast<int>(syscall(SYS_memfd_create, "dlr_lib", 1));
+  if (fd_ >= 0) path_ = "/proc/self/fd/" + std::to_string(fd_);
+#endif  // __linux__
+  if (fd_ < 0) {
+    // No memfd, write a temporary file instead.
+    const char* tmp_dir = std::getenv("TMPDIR");
+    std::string path = std::string(tmp_dir != nullptr ? tmp_dir : "/tmp") + "/dlr_lib_XXXXXX";
+    fd_ = mkstemp(&path[0]);
+    if (fd_ < 0) throw dmlc::Error("Unable to create a file for the shared library: " + path);
+    path_ = path;
+    temp_file_ = true;
+  }
+  const char* bytes = static_cast<const char*>(data);
+  for (size_t written = 0; written < size;) {
+    ssize_t n = write(fd_, bytes + written, size - written);
+    if (n < 0) {
+      close(fd_);
+      if (temp_file_) unlink(path_.c_str());
+      throw dmlc::Error("Unable to write the shared library to " + path_);
+    }
+    written += static_cast<size_t>(n);
+  }
+#endif  // _WIN32
+}
+
+InMemoryLibrary::~InMemoryLibrary() {
+#ifndef _WIN32
+  if (fd_ >= 0) close(fd_);
+  if (temp_file_) unlink(path_.c_str());
+#endif  // _WIN32
+}
+
 std::vector<std::string> dlr::FindFiles(const std::vector<std::string>& paths) {
   std::vector<std::string> files;
   for (auto path : paths) {
@@ -135,7 +223,9 @@ DLRBackend dlr::GetBackend(const std::vector<std::string>& files) {
 DLRBackend dlr::GetBackend(const std::vector<DLRModelElem>& model_elems) {
   bool has_tvm_lib = false;
   for (DLRModelElem el : model_elems) {
-    if (el.type == DLRModelElemType::TVM_PARAMS) {
+    if (el.type == DLRModelElemType::TVM_PARAMS || el.type == DLRModelElemType::TVM_PARAMS_MMAP ||
+        el.type == DLRModelElemType::TVM_PARAMS_SHARED ||
+        el.type == DLRModelElemType::TVM_PARAMS_SHM) {
       return DLRBackend::kTVM;
     } else if (el.type == DLRModelElemType::RELAY_EXEC) {
       return DLRBackend::kRELAYVM;
@@ -210,6 +300,20 @@ const std::vector<int64_t>& DLRModel::GetInputShape(int index) const {
   return input_shapes_[index];
 }
 
+std::future<void> DLRModel::RunAsync(std::function<void(std::exception_ptr)> callback) {
+  return ThreadPool::Global().Submit([this, callback]() {
+    std::exception_ptr error;
+    try {
+      std::lock_guard<std::mutex> lock(*run_mutex_);
+      Run();
+    } catch (...) {
+      error = std::current_exception();
+    }
+    if (callback) callback(error);
+    if (error) std::rethrow_exception(error);
+  });
+}
+
 bool DLRModel::HasMetadata() const { return !this->metadata_.is_null(); }
 
 void DLRModel::ValidateDeviceTypeIfExists() {
@@ -309,6 +413,16 @@ bool dlr::HasNegative(const int64_t* arr, const size_t size) {
   return std::any_of(arr, arr + size, [](int64_t x) { return x < 0; });
 }
 
+size_t dlr::GetDataTypeBytes(const std::string& type) {
+  if (type == "bool") return 1;
+  const size_t pos = type.find_first_of("0123456789");
+  if (pos == std::string::npos) {
+    throw dmlc::Error("Unknown data type: " + type);
+  }
+  const int bits = std::stoi(type.substr(pos));
+  return static_cast<size_t>((bits + 7) / 8);
+}
+
 std::vector<std::string> dlr::MakePathVec(std::string model_path) {
   std::vector<std::string> path_vec;
   int start = 0;
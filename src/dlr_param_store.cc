@@ -0,0 +1,555 @@
+#include "dlr_param_store.h"
+
+#include <dmlc/logging.h>
+#include <dmlc/memory_io.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+#if !defined(_WIN32) && !defined(__ANDROID__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DLR_SHARED_MEMORY_SEGMENTS
+#endif
+
+#ifdef DLR_ZSTD
+#include <zstd.h>
+#endif  // DLR_ZSTD
+
+#include "dlr_thread_pool.h"
+
+using namespace dlr;
+
+namespace {
+
+constexpr uint64_t kHashPrime = 0x9E3779B97F4A7C15ULL;
+
+inline uint64_t MixHash(uint64_t h, uint64_t v) {
+  v *= kHashPrime;
+  v ^= v >> 29;
+  return (h ^ v) * 0xBF58476D1CE4E5B9ULL;
+}
+
+bool SameLayout(const DLTensor& a, const DLTensor& b) {
+  if (a.ndim != b.ndim || a.dtype.code != b.dtype.code || a.dtype.bits != b.dtype.bits ||
+      a.dtype.lanes != b.dtype.lanes) {
+    return false;
+  }
+  return std::equal(a.shape, a.shape + a.ndim, b.shape);
+}
+
+}  // namespace
+
+uint64_t ParamStore::Hash(const void* data, size_t size) {
+  const char* bytes = static_cast<const char*>(data);
+  uint64_t h = MixHash(0, size);
+  size_t i = 0;
+  for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t)) {
+    uint64_t word;
+    std::memcpy(&word, bytes + i, sizeof(word));
+    h = MixHash(h, word);
+  }
+  if (i < size) {
+    uint64_t word = 0;
+    std::memcpy(&word, bytes + i, size - i);
+    h = MixHash(h, word);
+  }
+  return h ^ (h >> 31);
+}
+
+tvm::runtime::NDArray ParamStore::Acquire(const DLTensor& tensor, const DLDevice& dev) {
+  CHECK_EQ(tensor.device.device_type, kDLCPU) << "ParamStore expects host tensors.";
+  const size_t size = tvm::runtime::GetDataSize(tensor);
+  const char* data = static_cast<const char*>(tensor.data) + tensor.byte_offset;
+  // Hashing is the bulk of the work and needs no lock.
+  uint64_t hash = Hash(data, size);
+  hash = MixHash(hash, (static_cast<uint64_t>(tensor.dtype.code) << 32) |
+                           (static_cast<uint64_t>(tensor.dtype.bits) << 16) | tensor.dtype.lanes);
+  for (int i = 0; i < tensor.ndim; i++) hash = MixHash(hash, tensor.shape[i]);
+  hash = MixHash(hash, (static_cast<uint64_t>(dev.device_type) << 32) | dev.device_id);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<Entry>& bucket = entries_[hash];
+  std::vector<char> host;
+  for (Entry& entry : bucket) {
+    const DLTensor* stored = entry.array.operator->();
+    if (!SameLayout(*stored, tensor)) continue;
+    const char* stored_data = static_cast<const char*>(stored->data);
+    if (dev.device_type != kDLCPU) {
+      host.resize(size);
+      entry.array.CopyToBytes(host.data(), size);
+      stored_data = host.data();
+    }
+    if (std::memcmp(stored_data, data, size) != 0) continue;
+    entry.num_refs++;
+    stats_.deduplicated_bytes += size;
+    return entry.array;
+  }
+  tvm::runtime::NDArray array = tvm::runtime::NDArray::Empty(
+      std::vector<int64_t>(tensor.shape, tensor.shape + tensor.ndim), tensor.dtype, dev);
+  array.CopyFromBytes(data, size);
+  bucket.push_back({array, 1});
+  hashes_[array->data] = hash;
+  stats_.stored_bytes += size;
+  stats_.num_tensors++;
+  return array;
+}
+
+void ParamStore::Release(const tvm::runtime::NDArray& array) {
+  const size_t size = tvm::runtime::GetDataSize(*array.operator->());
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = hashes_.find(array->data);
+  CHECK(it != hashes_.end()) << "Array was not acquired from the ParamStore.";
+  std::vector<Entry>& bucket = entries_[it->second];
+  for (auto entry = bucket.begin(); entry != bucket.end(); ++entry) {
+    if (entry->array->data != array->data) continue;
+    if (--entry->num_refs > 0) {
+      stats_.deduplicated_bytes -= size;
+      return;
+    }
+    stats_.stored_bytes -= size;
+    stats_.num_tensors--;
+    bucket.erase(entry);
+    if (bucket.empty()) entries_.erase(it->second);
+    hashes_.erase(it);
+    return;
+  }
+}
+
+ParamStoreStats ParamStore::GetStats() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+ParamStore& ParamStore::Global() {
+  // Never destroyed, models may release their weights during static destruction.
+  static ParamStore* store = new ParamStore();
+  return *store;
+}
+
+namespace {
+
+constexpr uint64_t kSegmentMagic = 0x444C5253484D3031ULL;  // "DLRSHM01"
+/*! \brief Header before the data of a SharedMemorySegment, padded to keep the data aligned. */
+struct SegmentHeader {
+  uint64_t magic;
+  uint64_t size;
+  /*! \brief Set to 1 by the creator once the data is complete. */
+  uint32_t ready;
+};
+constexpr size_t kSegmentHeaderSize = 64;
+static_assert(sizeof(SegmentHeader) <= kSegmentHeaderSize, "SegmentHeader too large");
+
+/*! \brief Attempts to find the segment complete before giving up on it. */
+constexpr int kSegmentOpenAttempts = 200;
+
+}  // namespace
+
+SharedMemorySegment::~SharedMemorySegment() {
+#ifdef DLR_SHARED_MEMORY_SEGMENTS
+  if (addr_ != nullptr) munmap(addr_, mapped_size_);
+#endif
+  addr_ = nullptr;
+}
+
+const char* SharedMemorySegment::GetData() const {
+  return static_cast<const char*>(addr_) + kSegmentHeaderSize;
+}
+
+#ifdef DLR_SHARED_MEMORY_SEGMENTS
+std::unique_ptr<SharedMemorySegment> SharedMemorySegment::Create(
+    int fd, const std::string& name, size_t size, const std::function<void(char*)>& fill) {
+  std::unique_ptr<SharedMemorySegment> segment(new SharedMemorySegment());
+  segment->size_ = size;
+  segment->mapped_size_ = kSegmentHeaderSize + size;
+  // Hold an exclusive lock while filling, other processes wait for it with a shared one.
+  // The lock goes away with the process, so a crash leaves the segment unlocked and not
+  // ready.
+  if (flock(fd, LOCK_EX) != 0 || ftruncate(fd, static_cast<off_t>(segment->mapped_size_)) != 0) {
+    LOG(WARNING) << "Unable to create shared memory segment " << name;
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  void* addr = mmap(nullptr, segment->mapped_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (addr == MAP_FAILED) {
+    LOG(WARNING) << "Unable to map shared memory segment " << name;
+    close(fd);
+    shm_unlink(name.c_str());
+    return nullptr;
+  }
+  segment->addr_ = addr;
+  try {
+    fill(static_cast<char*>(addr) + kSegmentHeaderSize);
+  } catch (...) {
+    close(fd);
+    shm_unlink(name.c_str());
+    throw;
+  }
+  SegmentHeader* header = static_cast<SegmentHeader*>(addr);
+  header->magic = kSegmentMagic;
+  header->size = size;
+  __atomic_store_n(&header->ready, 1, __ATOMIC_RELEASE);
+  mprotect(addr, segment->mapped_size_, PROT_READ);
+  close(fd);
+  return segment;
+}
+
+std::unique_ptr<SharedMemorySegment> SharedMemorySegment::Open(int fd, const std::string& name,
+                                                               size_t size) {
+  std::unique_ptr<SharedMemorySegment> segment(new SharedMemorySegment());
+  segment->size_ = size;
+  segment->mapped_size_ = kSegmentHeaderSize + size;
+  const off_t mapped_size = static_cast<off_t>(segment->mapped_size_);
+  // Only a segment found sized and not ready while holding the lock is known to be abandoned.
+  // Failures to lock or map it say nothing about the segment, which is then left alone.
+  bool abandoned = false;
+  for (int attempt = 0; attempt < kSegmentOpenAttempts; attempt++) {
+    // Blocks while the creator fills the segment.
+    if (flock(fd, LOCK_SH) != 0) {
+      if (errno == EINTR) continue;
+      break;
+    }
+    struct stat st;
+    const bool sized = fstat(fd, &st) == 0 && st.st_size == mapped_size;
+    if (sized) {
+      void* addr = mmap(nullptr, segment->mapped_size_, PROT_READ, MAP_SHARED, fd, 0);
+      if (addr != MAP_FAILED) {
+        const SegmentHeader* header = static_cast<const SegmentHeader*>(addr);
+        if (__atomic_load_n(&header->ready, __ATOMIC_ACQUIRE) == 1 &&
+            header->magic == kSegmentMagic && header->size == size) {
+          flock(fd, LOCK_UN);
+          close(fd);
+          segment->addr_ = addr;
+          return segment;
+        }
+        munmap(addr, segment->mapped_size_);
+        // Sized but unlocked and not ready: the creator died while filling it.
+        abandoned = true;
+      }
+      flock(fd, LOCK_UN);
+      break;
+    }
+    // Not sized yet: the creator has not taken its lock yet.
+    flock(fd, LOCK_UN);
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  close(fd);
+  if (abandoned) {
+    LOG(WARNING) << "Removing incomplete shared memory segment " << name;
+    shm_unlink(name.c_str());
+  } else {
+    LOG(WARNING) << "Unable to open shared memory segment " << name;
+  }
+  return nullptr;
+}
+#endif  // DLR_SHARED_MEMORY_SEGMENTS
+
+std::unique_ptr<SharedMemorySegment> SharedMemorySegment::OpenOrCreate(
+    const std::string& name, size_t size, const std::function<void(char*)>& fill) {
+#ifdef DLR_SHARED_MEMORY_SEGMENTS
+  // The second round only follows the removal of an empty segment.
+  for (int round = 0; round < 2; round++) {
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) return Create(fd, name, size, fill);
+    if (errno != EEXIST) {
+      LOG(WARNING) << "Unable to open shared memory segment " << name << ": " << strerror(errno);
+      return nullptr;
+    }
+    fd = shm_open(name.c_str(), O_RDONLY, 0);
+    // Removed in between, create it.
+    if (fd < 0) continue;
+    // Segments of other users may hold anything under the expected name.
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_uid != geteuid()) {
+      LOG(WARNING) << "Shared memory segment " << name << " is not owned by this user.";
+      close(fd);
+      return nullptr;
+    }
+    // Empty: the creator died before sizing it, or has not taken its lock yet. The segment is
+    // created again rather than waited for. A creator still running then fills a segment which
+    // only it maps.
+    if (st.st_size == 0 && round == 0) {
+      close(fd);
+      shm_unlink(name.c_str());
+      continue;
+    }
+    return Open(fd, name, size);
+  }
+  return nullptr;
+#else
+  LOG(WARNING) << "Shared memory segments are not supported on this platform.";
+  return nullptr;
+#endif  // DLR_SHARED_MEMORY_SEGMENTS
+}
+
+void SharedMemorySegment::Remove(const std::string& name) {
+#ifdef DLR_SHARED_MEMORY_SEGMENTS
+  shm_unlink(name.c_str());
+#endif
+}
+
+std::string dlr::GetSharedParamsName(const char* params_data, size_t params_size) {
+  // The layout version and a hash of the whole blob, so segments of other DLR versions or
+  // other params are never reused.
+  std::ostringstream name;
+  name << "/dlr_params_v1_" << std::hex << std::setfill('0') << std::setw(16)
+       << ParamStore::Hash(params_data, params_size) << "_" << params_size;
+  return name.str();
+}
+
+namespace {
+
+size_t AlignUp(size_t value) {
+  const size_t align = tvm::runtime::kAllocAlignment;
+  return (value + align - 1) / align * align;
+}
+
+std::vector<std::string> ForEachSnapshotParam(
+    const char* data, size_t size,
+    const std::function<void(const std::string&, std::vector<int64_t>*, DLTensor*)>& fn) {
+  CHECK(DMLC_IO_NO_ENDIAN_SWAP) << "Params snapshots are not supported on big endian platforms.";
+  dmlc::MemoryFixedSizeStream strm(const_cast<char*>(data), size);
+  strm.Seek(sizeof(kParamsSnapshotMagic));
+  uint32_t version, reserved;
+  CHECK(strm.Read(&version) && version == kParamsSnapshotVersion)
+      << "Unsupported params snapshot version";
+  CHECK(strm.Read(&reserved)) << "Invalid params snapshot format";
+  std::vector<std::string> names;
+  CHECK(strm.Read(&names)) << "Invalid params snapshot format";
+  std::vector<DLDataType> dtypes(names.size());
+  std::vector<std::vector<int64_t>> shapes(names.size());
+  std::vector<uint64_t> offsets(names.size());
+  std::vector<uint64_t> sizes(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    int ndim;
+    CHECK(strm.Read(&dtypes[i])) << "Invalid params snapshot format";
+    CHECK(strm.Read(&ndim) && ndim >= 0) << "Invalid params snapshot format";
+    shapes[i].resize(ndim);
+    if (ndim != 0) {
+      CHECK(strm.ReadArray(shapes[i].data(), ndim)) << "Invalid params snapshot format";
+    }
+    CHECK(strm.Read(&offsets[i]) && strm.Read(&sizes[i])) << "Invalid params snapshot format";
+  }
+  const size_t data_start = AlignUp(strm.Tell());
+  for (size_t i = 0; i < names.size(); i++) {
+    CHECK(data_start <= size && offsets[i] <= size - data_start &&
+          sizes[i] <= size - data_start - offsets[i])
+        << "Invalid params snapshot format";
+    DLTensor tensor;
+    tensor.data = const_cast<char*>(data + data_start + offsets[i]);
+    tensor.device = DLDevice{kDLCPU, 0};
+    tensor.ndim = static_cast<int>(shapes[i].size());
+    tensor.dtype = dtypes[i];
+    tensor.shape = shapes[i].data();
+    tensor.strides = nullptr;
+    tensor.byte_offset = 0;
+    CHECK_EQ(tvm::runtime::GetDataSize(tensor), sizes[i]) << "Invalid params snapshot format";
+    fn(names[i], &shapes[i], &tensor);
+  }
+  return names;
+}
+
+}  // namespace
+
+std::vector<std::string> dlr::ForEachParam(
+    const char* params_data, size_t params_size,
+    const std::function<void(const std::string&, std::vector<int64_t>*, DLTensor*)>& fn) {
+  if (IsParamsSnapshot(params_data, params_size)) {
+    return ForEachSnapshotParam(params_data, params_size, fn);
+  }
+  dmlc::MemoryFixedSizeStream strm(const_cast<char*>(params_data), params_size);
+  uint64_t header, reserved;
+  CHECK(strm.Read(&header) && header == tvm::runtime::kTVMNDArrayListMagic)
+      << "Invalid parameters file format";
+  CHECK(strm.Read(&reserved)) << "Invalid parameters file format";
+  std::vector<std::string> names;
+  CHECK(strm.Read(&names)) << "Invalid parameters file format";
+  uint64_t num_params;
+  CHECK(strm.Read(&num_params) && num_params == names.size()) << "Invalid parameters file format";
+
+  for (size_t i = 0; i < names.size(); i++) {
+    uint64_t tensor_header, tensor_reserved;
+    DLDevice tensor_dev;
+    int ndim;
+    DLDataType dtype;
+    CHECK(strm.Read(&tensor_header) && tensor_header == tvm::runtime::kTVMNDArrayMagic)
+        << "Invalid DLTensor file format";
+    CHECK(strm.Read(&tensor_reserved)) << "Invalid DLTensor file format";
+    CHECK(strm.Read(&tensor_dev)) << "Invalid DLTensor file format";
+    CHECK(strm.Read(&ndim)) << "Invalid DLTensor file format";
+    CHECK(strm.Read(&dtype)) << "Invalid DLTensor file format";
+    std::vector<int64_t> shape(ndim);
+    if (ndim != 0) {
+      CHECK(strm.ReadArray(shape.data(), ndim)) << "Invalid DLTensor file format";
+    }
+    int64_t data_byte_size;
+    CHECK(strm.Read(&data_byte_size)) << "Invalid DLTensor file format";
+    const size_t offset = strm.Tell();
+    CHECK_LE(offset + data_byte_size, params_size) << "Invalid DLTensor file format";
+    strm.Seek(offset + data_byte_size);
+
+    DLTensor tensor;
+    tensor.data = const_cast<char*>(params_data + offset);
+    tensor.device = DLDevice{kDLCPU, 0};
+    tensor.ndim = ndim;
+    tensor.dtype = dtype;
+    tensor.shape = shape.data();
+    tensor.strides = nullptr;
+    tensor.byte_offset = 0;
+    fn(names[i], &shape, &tensor);
+  }
+  return names;
+}
+
+bool dlr::IsCompressedParams(const char* data, size_t size) {
+  return size >= sizeof(kCompressedParamsMagic) &&
+         std::memcmp(data, kCompressedParamsMagic, sizeof(kCompressedParamsMagic)) == 0;
+}
+
+std::vector<CompressedParam> dlr::ReadCompressedParams(const char* data, size_t size) {
+  CHECK(DMLC_IO_NO_ENDIAN_SWAP) << "Compressed params are not supported on big endian platforms.";
+  CHECK(IsCompressedParams(data, size)) << "Invalid compressed parameters format";
+  dmlc::MemoryFixedSizeStream strm(const_cast<char*>(data), size);
+  strm.Seek(sizeof(kCompressedParamsMagic));
+  uint32_t version, codec;
+  CHECK(strm.Read(&version) && version == kCompressedParamsVersion)
+      << "Unsupported compressed parameters version";
+  CHECK(strm.Read(&codec) && codec == kCompressedParamsCodecZstd)
+      << "Unsupported compressed parameters codec";
+  std::vector<std::string> names;
+  CHECK(strm.Read(&names)) << "Invalid compressed parameters format";
+  std::vector<CompressedParam> params(names.size());
+  std::vector<uint64_t> offsets(names.size());
+  for (size_t i = 0; i < names.size(); i++) {
+    CompressedParam& param = params[i];
+    param.name = std::move(names[i]);
+    int ndim;
+    CHECK(strm.Read(&param.dtype)) << "Invalid compressed parameters format";
+    CHECK(strm.Read(&ndim) && ndim >= 0) << "Invalid compressed parameters format";
+    param.shape.resize(ndim);
+    if (ndim != 0) {
+      CHECK(strm.ReadArray(param.shape.data(), ndim)) << "Invalid compressed parameters format";
+    }
+    CHECK(strm.Read(&param.size) && strm.Read(&offsets[i]) && strm.Read(&param.frame_size))
+        << "Invalid compressed parameters format";
+  }
+  const size_t frames = strm.Tell();
+  for (size_t i = 0; i < params.size(); i++) {
+    CHECK(offsets[i] <= size - frames && params[i].frame_size <= size - frames - offsets[i])
+        << "Invalid compressed parameters format";
+    params[i].frame = data + frames + offsets[i];
+  }
+  return params;
+}
+
+void dlr::DecompressParam(const CompressedParam& param, void* dst) {
+#ifdef DLR_ZSTD
+  const size_t size = ZSTD_decompress(dst, param.size, param.frame, param.frame_size);
+  if (ZSTD_isError(size) || size != param.size) {
+    throw dmlc::Error("Unable to decompress weight " + param.name);
+  }
+#else
+  throw dmlc::Error("Compressed params require DLR built with USE_ZSTD.");
+#endif  // DLR_ZSTD
+}
+
+std::string dlr::CompressParams(const char* params_data, size_t params_size, int level) {
+#ifdef DLR_ZSTD
+  std::vector<CompressedParam> params;
+  std::vector<const char*> sources;
+  ForEachParam(params_data, params_size,
+               [&](const std::string& name, std::vector<int64_t>* shape, DLTensor* tensor) {
+                 params.push_back({name, tensor->dtype, std::move(*shape),
+                                   tvm::runtime::GetDataSize(*tensor), nullptr, 0});
+                 sources.push_back(static_cast<const char*>(tensor->data));
+               });
+  std::vector<std::string> frames(params.size());
+  std::atomic<size_t> next{0};
+  ThreadPool::Compute().ParallelFor(params.size(), [&](size_t, size_t) {
+    for (size_t i = next++; i < params.size(); i = next++) {
+      frames[i].resize(ZSTD_compressBound(params[i].size));
+      const size_t size =
+          ZSTD_compress(&frames[i][0], frames[i].size(), sources[i], params[i].size, level);
+      if (ZSTD_isError(size)) {
+        throw dmlc::Error("Unable to compress weight " + params[i].name);
+      }
+      frames[i].resize(size);
+    }
+  });
+
+  std::string out;
+  dmlc::MemoryStringStream strm(&out);
+  strm.Write(kCompressedParamsMagic, sizeof(kCompressedParamsMagic));
+  strm.Write(kCompressedParamsVersion);
+  strm.Write(kCompressedParamsCodecZstd);
+  std::vector<std::string> names;
+  for (const CompressedParam& param : params) names.push_back(param.name);
+  strm.Write(names);
+  uint64_t offset = 0;
+  for (size_t i = 0; i < params.size(); i++) {
+    const int ndim = static_cast<int>(params[i].shape.size());
+    const uint64_t frame_size = frames[i].size();
+    strm.Write(params[i].dtype);
+    strm.Write(ndim);
+    if (ndim != 0) strm.WriteArray(params[i].shape.data(), ndim);
+    strm.Write(params[i].size);
+    strm.Write(offset);
+    strm.Write(frame_size);
+    offset += frame_size;
+  }
+  for (const std::string& frame : frames) strm.Write(frame.data(), frame.size());
+  return out;
+#else
+  throw dmlc::Error("Compressed params require DLR built with USE_ZSTD.");
+#endif  // DLR_ZSTD
+}
+
+bool dlr::IsParamsSnapshot(const char* data, size_t size) {
+  return size >= sizeof(kParamsSnapshotMagic) &&
+         std::memcmp(data, kParamsSnapshotMagic, sizeof(kParamsSnapshotMagic)) == 0;
+}
+
+std::string dlr::WriteParamsSnapshot(const std::vector<std::string>& names,
+                                     const std::vector<tvm::runtime::NDArray>& arrays) {
+  CHECK_EQ(names.size(), arrays.size());
+  std::string out;
+  dmlc::MemoryStringStream strm(&out);
+  strm.Write(kParamsSnapshotMagic, sizeof(kParamsSnapshotMagic));
+  strm.Write(kParamsSnapshotVersion);
+  strm.Write(static_cast<uint32_t>(0));
+  strm.Write(names);
+  std::vector<uint64_t> offsets;
+  uint64_t offset = 0;
+  for (const tvm::runtime::NDArray& array : arrays) {
+    const DLTensor* tensor = array.operator->();
+    CHECK_EQ(tensor->device.device_type, kDLCPU)
+        << "Params snapshots are written from host arrays.";
+    const uint64_t size = tvm::runtime::GetDataSize(*tensor);
+    strm.Write(tensor->dtype);
+    strm.Write(tensor->ndim);
+    if (tensor->ndim != 0) strm.WriteArray(tensor->shape, tensor->ndim);
+    strm.Write(offset);
+    strm.Write(size);
+    offsets.push_back(offset);
+    offset = AlignUp(offset + size);
+  }
+  const size_t data_start = AlignUp(out.size());
+  out.resize(data_start + offset, '\0');
+  for (size_t i = 0; i < arrays.size(); i++) {
+    const DLTensor* tensor = arrays[i].operator->();
+    std::memcpy(&out[data_start + offsets[i]],
+                static_cast<const char*>(tensor->data) + tensor->byte_offset,
+                tvm::runtime::GetDataSize(*tensor));
+  }
+  return out;
+}
@@ -7,8 +7,20 @@
 #include <iterator>
 #include <numeric>
 
+#include "dlr_relayvm.h"
+#include "dlr_tvm.h"
+
 using namespace dlr;
 
+static std::vector<int64_t> FetchOutputShape(const DLRModelPtr& model, int index) {
+  int64_t size;
+  int dim;
+  model->GetOutputSizeDim(index, &size, &dim);
+  std::vector<int64_t> shape(dim, -1);
+  model->GetOutputShape(index, shape.data());
+  return shape;
+}
+
 void PipelineModel::CheckModelsCompatibility(const DLRModelPtr& m0, const DLRModelPtr& m1,
                                              const int m1_id, const bool is_runtime_check) {
   if (!is_runtime_check) {
@@ -66,13 +78,33 @@ void PipelineModel::SetupPipelineModel() {
     input_shapes_.push_back(dlr_models_[0]->GetInputShape(i));
   }
   // Check previous model outputs and current model inputs compatibility
+  runtime_check_required_.assign(count_, false);
+  checked_shapes_.resize(count_);
+  zero_copy_.assign(count_, false);
+  bound_inputs_.resize(count_);
   for (int i = 1; i < count_; i++) {
     const DLRModelPtr prev_model = dlr_models_[i - 1];
     const DLRModelPtr curr_model = dlr_models_[i];
     CheckModelsCompatibility(prev_model, curr_model, i /*m1_id*/, false /*is_runtime_check*/);
+    const DLRBackend prev_backend = prev_model->GetBackend();
+    const DLRBackend curr_backend = curr_model->GetBackend();
+    zero_copy_[i] = (prev_backend == DLRBackend::kTVM || prev_backend == DLRBackend::kRELAYVM) &&
+                    (curr_backend == DLRBackend::kTVM || curr_backend == DLRBackend::kRELAYVM);
+    bound_inputs_[i].assign(curr_model->GetNumInputs(), nullptr);
+    // Sizes and shapes known now were checked above, only dynamic ones need a check per Run.
+    for (int j = 0; j < curr_model->GetNumInputs(); j++) {
+      int64_t out_size;
+      int out_dim;
+      prev_model->GetOutputSizeDim(j, &out_size, &out_dim);
+      if (out_size < 0 || curr_model->GetInputSize(j) < 0) {
+        runtime_check_required_[i] = true;
+      }
+    }
   }
 }
 
+PipelineModel::~PipelineModel() { StopPipeline(); }
+
 std::vector<std::string> PipelineModel::GetWeightNames() const {
   return dlr_models_[0]->GetWeightNames();
 }
@@ -126,24 +158,67 @@ void PipelineModel::Run() {
   for (int i = 1; i < count_; i++) {
     const DLRModelPtr prev_model = dlr_models_[i - 1];
     const DLRModelPtr curr_model = dlr_models_[i];
-    CheckModelsCompatibility(prev_model, curr_model, i /*m1_id*/, true /*is_runtime_check*/);
+    if (runtime_check_required_[i]) {
+      // Dynamic shapes usually repeat, only check shapes that differ from the last checked ones.
+      std::vector<std::vector<int64_t>> shapes;
+      for (int j = 0; j < curr_model->GetNumInputs(); j++) {
+        shapes.push_back(FetchOutputShape(prev_model, j));
+      }
+      if (shapes != checked_shapes_[i]) {
+        CheckModelsCompatibility(prev_model, curr_model, i /*m1_id*/, true /*is_runtime_check*/);
+        checked_shapes_[i] = std::move(shapes);
+      }
+    }
     // for each model input
     for (int j = 0; j < curr_model->GetNumInputs(); j++) {
+      if (zero_copy_[i] && HandOffZeroCopy(i, j)) continue;
+      if (bound_inputs_[i][j] != nullptr) {
+        static_cast<TVMModel*>(curr_model.get())->ResetInputZeroCopy(j);
+        bound_inputs_[i][j] = nullptr;
+      }
       const char* input_name = curr_model->GetInputName(j);
       // Get output shape of previous output.
-      int64_t prev_output_size;
-      int prev_output_dim;
-      prev_model->GetOutputSizeDim(j, &prev_output_size, &prev_output_dim);
-      std::vector<int64_t> prev_output_shape(prev_output_dim, -1);
-      prev_model->GetOutputShape(j, prev_output_shape.data());
+      std::vector<int64_t> prev_output_shape = FetchOutputShape(prev_model, j);
       const void* prev_model_output = prev_model->GetOutputPtr(j);
       curr_model->SetInput(input_name, prev_output_shape.data(), prev_model_output,
-                           prev_output_dim);
+                           prev_output_shape.size());
     }
     curr_model->Run();
   }
 }
 
+bool PipelineModel::HandOffZeroCopy(int stage, int index) {
+  const DLRModelPtr& prev_model = dlr_models_[stage - 1];
+  tvm::runtime::NDArray output;
+  if (prev_model->GetBackend() == DLRBackend::kTVM) {
+    output = static_cast<TVMModel*>(prev_model.get())->GetOutputNDArray(index);
+  } else {
+    output = static_cast<RelayVMModel*>(prev_model.get())->GetOutputNDArray(index);
+  }
+  if (!output.defined()) return false;
+  if (dlr_models_[stage]->GetBackend() == DLRBackend::kRELAYVM) {
+    // RelayVM inputs are passed per run, the next SetInput replaces the binding.
+    return static_cast<RelayVMModel*>(dlr_models_[stage].get())->BindInputZeroCopy(index, output);
+  }
+  // TVM outputs keep their buffer across runs, so the binding is usually made once.
+  if (bound_inputs_[stage][index] == output->data) return true;
+  TVMModel* curr_model = static_cast<TVMModel*>(dlr_models_[stage].get());
+  if (!curr_model->BindInputZeroCopy(index, output.operator->())) return false;
+  bound_inputs_[stage][index] = output->data;
+  return true;
+}
+
+void PipelineModel::ResetZeroCopyBindings() {
+  for (int i = 1; i < count_; i++) {
+    for (size_t j = 0; j < bound_inputs_[i].size(); j++) {
+      if (bound_inputs_[i][j] != nullptr) {
+        static_cast<TVMModel*>(dlr_models_[i].get())->ResetInputZeroCopy(j);
+        bound_inputs_[i][j] = nullptr;
+      }
+    }
+  }
+}
+
 void PipelineModel::SetNumThreads(int threads) {
   // Try to set Number of Threads to pipeline models
   // Ignore the errors in case some of the models do not support this feature.
@@ -179,3 +254,125 @@ int PipelineModel::GetOutputIndex(const char* name) const {
 void PipelineModel::GetOutputByName(const char* name, void* out) {
   return dlr_models_.back()->GetOutputByName(name, out);
 }
+
+void PipelineModel::StartPipeline(size_t queue_capacity) {
+  std::lock_guard<std::mutex> lock(pipeline_mutex_);
+  if (!stage_threads_.empty()) return;
+  // Stages pass copies of their outputs, inputs must read the executors' own buffers again.
+  ResetZeroCopyBindings();
+  for (int i = 0; i < count_; i++) {
+    stage_queues_.emplace_back(new BoundedQueue<PipelineRequestPtr>(queue_capacity));
+  }
+  for (int i = 0; i < count_; i++) {
+    stage_threads_.emplace_back(&PipelineModel::StageLoop, this, i);
+  }
+}
+
+void PipelineModel::StopPipeline() {
+  std::lock_guard<std::mutex> lock(pipeline_mutex_);
+  if (stage_threads_.empty()) return;
+  // Each stage closes the queue of the next one once its own queue is drained.
+  stage_queues_[0]->Close();
+  for (std::thread& t : stage_threads_) {
+    t.join();
+  }
+  stage_threads_.clear();
+  stage_queues_.clear();
+}
+
+std::future<void> PipelineModel::RunPipelined(const void* const* inputs,
+                                              const int64_t* const* input_shapes,
+                                              void* const* outputs,
+                                              std::function<void(std::exception_ptr)> callback) {
+  StartPipeline();
+  PipelineRequestPtr request = std::make_shared<PipelineRequest>();
+  request->inputs.assign(inputs, inputs + num_inputs_);
+  for (int i = 0; i < num_inputs_; i++) {
+    if (input_shapes != nullptr) {
+      request->input_shapes.emplace_back(input_shapes[i], input_shapes[i] + GetInputDim(i));
+    } else {
+      request->input_shapes.push_back(input_shapes_[i]);
+    }
+  }
+  request->outputs.assign(outputs, outputs + num_outputs_);
+  request->callback = std::move(callback);
+  std::future<void> result = request->done.get_future();
+  CHECK(stage_queues_[0]->Push(std::move(request))) << "Pipeline is stopped.";
+  return result;
+}
+
+void PipelineModel::StageLoop(int stage) {
+  PipelineRequestPtr request;
+  while (stage_queues_[stage]->Pop(&request)) {
+    try {
+      RunStage(stage, request.get());
+    } catch (...) {
+      std::exception_ptr error = std::current_exception();
+      if (request->callback) request->callback(error);
+      request->done.set_exception(error);
+      continue;
+    }
+    if (stage + 1 < count_) {
+      stage_queues_[stage + 1]->Push(std::move(request));
+    } else {
+      if (request->callback) request->callback(nullptr);
+      request->done.set_value();
+    }
+  }
+  if (stage + 1 < count_) {
+    stage_queues_[stage + 1]->Close();
+  }
+}
+
+void PipelineModel::RunStage(int stage, PipelineRequest* request) {
+  const DLRModelPtr& model = dlr_models_[stage];
+  if (stage == 0) {
+    for (int j = 0; j < model->GetNumInputs(); j++) {
+      const std::vector<int64_t>& shape = request->input_shapes[j];
+      model->SetInput(model->GetInputName(j), shape.data(), request->inputs[j], shape.size());
+    }
+  } else {
+    if (runtime_check_required_[stage]) {
+      // The previous model may already run the next request, check the shapes passed along.
+      for (int j = 0; j < model->GetNumInputs(); j++) {
+        const std::vector<int64_t> in_shape = model->GetInputShape(j);
+        const std::vector<int64_t>& out_shape = request->tensor_shapes[j];
+        CHECK_EQ(in_shape.size(), out_shape.size())
+            << "Number of dimensions mismatch between output/input #" << j << ", models "
+            << stage - 1 << " and " << stage;
+        for (size_t k = 0; k < in_shape.size(); k++) {
+          if (in_shape[k] >= 0 && out_shape[k] >= 0) {
+            CHECK_EQ(in_shape[k], out_shape[k])
+                << "Shape mismatch between output/input #" << j << ", models " << stage - 1
+                << " and " << stage;
+          }
+        }
+      }
+    }
+    for (int j = 0; j < model->GetNumInputs(); j++) {
+      const std::vector<int64_t>& shape = request->tensor_shapes[j];
+      model->SetInput(model->GetInputName(j), shape.data(), request->tensors[j].data(),
+                      shape.size());
+    }
+  }
+  model->Run();
+  if (stage + 1 == count_) {
+    for (int j = 0; j < model->GetNumOutputs(); j++) {
+      model->GetOutput(j, request->outputs[j]);
+    }
+    return;
+  }
+  // Copy outputs into the request, the model is reused for the next request right away.
+  const int num_outputs = model->GetNumOutputs();
+  request->tensor_shapes.resize(num_outputs);
+  request->tensors.resize(num_outputs);
+  for (int j = 0; j < num_outputs; j++) {
+    int64_t size;
+    int dim;
+    model->GetOutputSizeDim(j, &size, &dim);
+    request->tensor_shapes[j].assign(dim, -1);
+    model->GetOutputShape(j, request->tensor_shapes[j].data());
+    request->tensors[j].resize(size * GetDataTypeBytes(model->GetOutputType(j)));
+    model->GetOutput(j, request->tensors[j].data());
+  }
+}
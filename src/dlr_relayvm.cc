@@ -2,14 +2,84 @@
 
 #include <stdlib.h>
 
+#include <algorithm>
+#include <cstring>
 #include <fstream>
 #include <iterator>
 #include <numeric>
 
+#include "dlr_allocator.h"
+
 using namespace dlr;
 
 const std::string RelayVMModel::ENTRY_FUNCTION = "main";
 
+namespace {
+
+/*! \brief Return a buffer of the given shape from buffers, allocating it if there is none. At
+ *         most max_buffers are kept, the oldest is dropped first.
+ */
+tvm::runtime::NDArray GetCachedBuffer(std::vector<tvm::runtime::NDArray>* buffers,
+                                      const int64_t* shape, int ndim, DLDataType dtype,
+                                      const DLDevice& dev, size_t max_buffers) {
+  // Compares the DLTensor fields, the shape container would be a copy on some TVM versions.
+  for (const tvm::runtime::NDArray& buffer : *buffers) {
+    if (TypeEqual(buffer->dtype, dtype) && buffer->ndim == ndim &&
+        std::equal(shape, shape + ndim, buffer->shape)) {
+      return buffer;
+    }
+  }
+  if (buffers->size() >= max_buffers) {
+    buffers->erase(buffers->begin());
+  }
+  buffers->push_back(
+      tvm::runtime::NDArray::Empty(std::vector<int64_t>(shape, shape + ndim), dtype, dev));
+  return buffers->back();
+}
+
+}  // namespace
+
+void dlr::CopyRegion(const char* src, const int64_t* src_shape, char* dst,
+                     const int64_t* dst_shape, int ndim, size_t elem_bytes) {
+  if (ndim == 0) {
+    std::memcpy(dst, src, elem_bytes);
+    return;
+  }
+  size_t src_stride = elem_bytes;
+  size_t dst_stride = elem_bytes;
+  for (int i = 1; i < ndim; i++) {
+    src_stride *= src_shape[i];
+    dst_stride *= dst_shape[i];
+  }
+  const int64_t rows = std::min(src_shape[0], dst_shape[0]);
+  if (src_stride == dst_stride) {
+    std::memcpy(dst, src, rows * src_stride);
+    return;
+  }
+  for (int64_t i = 0; i < rows; i++) {
+    CopyRegion(src + i * src_stride, src_shape + 1, dst + i * dst_stride, dst_shape + 1, ndim - 1,
+               elem_bytes);
+  }
+}
+
+bool dlr::GetSlicedOutputShape(const std::vector<int64_t>& metadata_shape,
+                               const std::vector<std::pair<int64_t, int64_t>>& padded_lengths,
+                               std::vector<int64_t>* shape) {
+  bool sliced = false;
+  for (size_t d = 0; d < shape->size(); d++) {
+    // Only dimensions which are dynamic in the metadata follow the input length.
+    if (d < metadata_shape.size() && metadata_shape[d] >= 0) continue;
+    for (const auto& lengths : padded_lengths) {
+      if ((*shape)[d] == lengths.first) {
+        (*shape)[d] = lengths.second;
+        sliced = true;
+        break;
+      }
+    }
+  }
+  return sliced;
+}
+
 void RelayVMModel::SetupVMModule(const std::vector<std::string>& files) {
   ModelPath path;
   dlr::InitModelPath(files, &path);
@@ -25,6 +95,8 @@ void RelayVMModel::SetupVMModule(const std::vector<std::string>& files) {
 }
 
 void RelayVMModel::SetupVMModule(const std::vector<DLRModelElem>& model_elems) {
+  load_phases_.clear();
+  PhaseTimer timer(&load_phases_);
   // Set custom allocators in TVM.
   if (dlr::DLRAllocatorFunctions::GetMemalignFunction() &&
       dlr::DLRAllocatorFunctions::GetFreeFunction()) {
@@ -55,14 +127,19 @@ void RelayVMModel::SetupVMModule(const std::vector<DLRModelElem>& model_elems) {
     } else if (el.type == DLRModelElemType::TVM_LIB) {
       if (el.path != nullptr) {
         model_lib_path = el.path;
+      } else if (el.data != nullptr && el.data_size > 0) {
+        lib_memory_.reset(new InMemoryLibrary(el.data, el.data_size));
+        model_lib_path = lib_memory_->GetPath();
       } else {
-        throw dmlc::Error("Invalid RelayVM model element TVM_LIB. TVM_LIB must be a file path.");
+        throw dmlc::Error("Invalid RelayVM model element TVM_LIB");
       }
     } else if (el.type == DLRModelElemType::NEO_METADATA) {
       if (el.path != nullptr) {
         metadata_data = dlr::LoadFileToString(el.path);
       } else if (el.data != nullptr) {
-        metadata_data = static_cast<const char*>(el.data);
+        // NUL-terminated, or sized like the sections of a model archive.
+        const char* text = static_cast<const char*>(el.data);
+        metadata_data = el.data_size > 0 ? std::string(text, el.data_size) : std::string(text);
       } else {
         throw dmlc::Error("Invalid model element NEO_METADATA");
       }
@@ -77,29 +154,68 @@ void RelayVMModel::SetupVMModule(const std::vector<DLRModelElem>& model_elems) {
   ValidateDeviceTypeIfExists();
   // Override allocator - default is kPooled.
   const char* val = std::getenv("DLR_RELAYVM_ALLOCATOR");
-  if ((metadata_.count("Model") && metadata_["Model"].count("RelayVMAllocator") &&
-       metadata_["Model"]["RelayVMAllocator"].get<std::string>() == "naive") ||
-      (val != nullptr && std::string(val) == "naive")) {
+  auto allocator_is = [&](const std::string& name) {
+    return (metadata_.count("Model") && metadata_["Model"].count("RelayVMAllocator") &&
+            metadata_["Model"]["RelayVMAllocator"].get<std::string>() == name) ||
+           (val != nullptr && std::string(val) == name);
+  };
+  if (allocator_is("naive")) {
     allocator_type_ = tvm::runtime::vm::AllocatorType::kNaive;
   }
+  if (metadata_.count("Model") && metadata_["Model"].count("ShapeBuckets")) {
+    try {
+      shape_buckets_ = metadata_["Model"]["ShapeBuckets"].get<std::vector<int64_t>>();
+    } catch (nlohmann::json::exception& e) {
+      throw dmlc::Error(std::string("Invalid ShapeBuckets in metadata: ") + e.what());
+    }
+    std::sort(shape_buckets_.begin(), shape_buckets_.end());
+  }
+  timer.Mark("read_elements");
+  // With the "dlr" allocator, the pooled allocator on CPU is DLRBufferPool::RelayVM(), which
+  // unlike TVM's pool buckets sizes, is capped and can be trimmed. The VM then allocates naively
+  // and the pool does the caching. TVM has a single process-wide CPU allocator and no per-VM
+  // one, so the pool then serves every model of the process. It is only installed on request
+  // and never together with the user's allocator functions, which cannot be set once it is.
+  tvm::runtime::vm::AllocatorType vm_allocator_type = allocator_type_;
+  if (allocator_type_ == tvm::runtime::vm::AllocatorType::kPooled && allocator_is("dlr") &&
+      dev_.device_type == DLDeviceType::kDLCPU) {
+    auto* pf = tvm::runtime::Registry::Get("runtime.contrib.set_custom_cpu_allocator");
+    if (dlr::DLRAllocatorFunctions::AnySet()) {
+      LOG(WARNING) << "The DLR RelayVM pool is not used with custom allocator functions.";
+    } else if (pf == nullptr) {
+      LOG(WARNING) << "Custom allocator functions are not available. Using TVM's pool.";
+    } else {
+      DLRBufferPool::SetRelayVMHookInstalled();
+      (*pf)(reinterpret_cast<void*>(&DLRBufferPool::RelayVMMemalign),
+            reinterpret_cast<void*>(&DLRBufferPool::RelayVMFree));
+      vm_allocator_type = tvm::runtime::vm::AllocatorType::kNaive;
+    }
+  }
 
-  tvm::runtime::Module lib = tvm::runtime::Module::LoadFromFile(model_lib_path);
+  // The path of an in-memory library has no extension to tell its format.
+  tvm::runtime::Module lib =
+      tvm::runtime::Module::LoadFromFile(model_lib_path, lib_memory_ ? "so" : "");
+  timer.Mark("load_library");
 
   vm_executable_ =
       std::make_shared<tvm::runtime::Module>(tvm::runtime::vm::Executable::Load(code_data, lib));
+  timer.Mark("load_executable");
   auto vm = tvm::runtime::make_object<tvm::runtime::vm::VirtualMachine>();
   vm->LoadExecutable(static_cast<tvm::runtime::vm::Executable*>(
       const_cast<tvm::runtime::Object*>(vm_executable_->get())));
   vm_module_ = std::make_shared<tvm::runtime::Module>(tvm::runtime::Module(vm));
 
+  set_input_ = vm_module_->GetFunction("set_input");
+  invoke_ = vm_module_->GetFunction("invoke");
   tvm::runtime::PackedFunc init = vm_module_->GetFunction("init");
   if (dev_.device_type == DLDeviceType::kDLCPU) {
-    init(static_cast<int>(dev_.device_type), dev_.device_id, static_cast<int>(allocator_type_));
+    init(static_cast<int>(dev_.device_type), dev_.device_id, static_cast<int>(vm_allocator_type));
   } else {
     // CPU context also must be initialized because input/output data comes from CPU.
-    init(static_cast<int>(dev_.device_type), dev_.device_id, static_cast<int>(allocator_type_),
-         static_cast<int>(DLDeviceType::kDLCPU), 0, static_cast<int>(allocator_type_));
+    init(static_cast<int>(dev_.device_type), dev_.device_id, static_cast<int>(vm_allocator_type),
+         static_cast<int>(DLDeviceType::kDLCPU), 0, static_cast<int>(vm_allocator_type));
   }
+  timer.Mark("init_vm");
 }
 
 void RelayVMModel::FetchInputNodesData() {
@@ -110,6 +226,10 @@ void RelayVMModel::FetchInputNodesData() {
   input_types_.resize(num_inputs_);
   input_shapes_.resize(num_inputs_);
   inputs_.resize(num_inputs_);
+  input_buffers_.resize(num_inputs_);
+  unpadded_shapes_.resize(num_inputs_);
+  input_values_.resize(num_inputs_ + 1);
+  input_type_codes_.resize(num_inputs_ + 1);
 
   try {
     for (int i = 0; i < num_inputs_; i++) {
@@ -135,6 +255,7 @@ void RelayVMModel::FetchOutputNodesData() {
   output_names_.resize(num_outputs_);
   output_types_.resize(num_outputs_);
   output_shapes_.resize(num_outputs_);
+  output_buffers_.resize(num_outputs_);
   try {
     for (int i = 0; i < num_outputs_; i++) {
       output_names_[i] = metadata_.at("Model").at("Outputs").at(i).at("name");
@@ -190,6 +311,16 @@ void RelayVMModel::GetInput(const char* name, void* input) {
 
   int index = GetInputIndex(name);
   auto in_array = inputs_[index];
+  if (!unpadded_shapes_[index].empty()) {
+    // Return the input as given, without padding.
+    if (in_array->device.device_type != DLDeviceType::kDLCPU) {
+      in_array = in_array.CopyTo(DLDevice{DLDeviceType::kDLCPU, 0});
+    }
+    CopyRegion(static_cast<const char*>(in_array->data), in_array->shape,
+               static_cast<char*>(input), unpadded_shapes_[index].data(), in_array->ndim,
+               (in_array->dtype.bits * in_array->dtype.lanes + 7) / 8);
+    return;
+  }
   DLTensor input_tensor;
   input_tensor.data = input;
   input_tensor.device = dev_;
@@ -208,9 +339,8 @@ int RelayVMModel::GetInputIndex(const char* name) const {
   }
 #endif
 
-  std::string input_name(name);
   for (auto i = 0; i < num_inputs_; i++) {
-    if (input_name == input_names_[i]) {
+    if (input_names_[i] == name) {
       return i;
     }
   }
@@ -230,7 +360,7 @@ const int64_t RelayVMModel::GetInputSize(int index) const {
 }
 
 DLDataType RelayVMModel::GetInputDLDataType(int index) {
-  auto input_type = input_types_[index];
+  const std::string& input_type = input_types_[index];
   DLDataType dtype;
   dtype.lanes = 1;
   if (input_type == "bool") {
@@ -293,6 +423,10 @@ void RelayVMModel::SetInput(const char* name, const int64_t* shape, const void*
 
   int index = GetInputIndex(name);
   DLDataType dtype = GetInputDLDataType(index);
+  if (!shape_buckets_.empty() && SetInputPadded(index, shape, input, dim, dtype)) {
+    return;
+  }
+  unpadded_shapes_[index].clear();
   DLTensor input_tensor;
   input_tensor.data = const_cast<void*>(input);
   input_tensor.device = DLDevice{DLDeviceType::kDLCPU, 0};
@@ -301,19 +435,98 @@ void RelayVMModel::SetInput(const char* name, const int64_t* shape, const void*
   input_tensor.strides = nullptr;
   input_tensor.byte_offset = 0;
   input_tensor.dtype = dtype;
-  std::vector<int64_t> arr_shape(shape, shape + dim);
-
-  // Only allocate new buffer if not initialized or if shape or dtype has changed. Context will
-  // always match.
-  if (inputs_[index] == empty_ ||
-      !std::equal(inputs_[index].Shape().begin(), inputs_[index].Shape().end(), arr_shape.begin(),
-                  arr_shape.end()) ||
-      !TypeEqual(inputs_[index].DataType(), dtype)) {
-    inputs_[index] = tvm::runtime::NDArray::Empty(arr_shape, dtype, dev_);
+  // Buffers from AllocDLRInputBuffer are passed to the VM in place.
+  if (dev_.device_type == DLDeviceType::kDLCPU && DLRBufferPool::Global().Contains(input) &&
+      SetInputZeroCopy(index, &input_tensor)) {
+    return;
   }
+  inputs_[index] = GetInputBuffer(index, shape, dim, dtype);
   inputs_[index].CopyFrom(&input_tensor);
 }
 
+tvm::runtime::NDArray RelayVMModel::GetInputBuffer(int index, const int64_t* shape, int ndim,
+                                                   DLDataType dtype) {
+  // Context will always match.
+  return GetCachedBuffer(&input_buffers_[index], shape, ndim, dtype, dev_, kMaxInputBuffers);
+}
+
+bool RelayVMModel::SetInputPadded(int index, const int64_t* shape, const void* input, int dim,
+                                  DLDataType dtype) {
+  const std::vector<int64_t>& model_shape = input_shapes_[index];
+  if (static_cast<size_t>(dim) != model_shape.size()) return false;
+  // Member scratch, so steady-state padding does not allocate.
+  padded_shape_.assign(shape, shape + dim);
+  for (int i = 0; i < dim; i++) {
+    if (model_shape[i] >= 0) continue;
+    // Lengths above the largest bucket are left as they are.
+    auto bucket = std::lower_bound(shape_buckets_.begin(), shape_buckets_.end(), shape[i]);
+    if (bucket != shape_buckets_.end()) padded_shape_[i] = *bucket;
+  }
+  if (std::equal(padded_shape_.begin(), padded_shape_.end(), shape)) return false;
+
+  const size_t elem_bytes = (dtype.bits * dtype.lanes + 7) / 8;
+  const size_t padded_bytes =
+      std::accumulate(padded_shape_.begin(), padded_shape_.end(), size_t{1},
+                      std::multiplies<size_t>()) *
+      elem_bytes;
+  tvm::runtime::NDArray buffer = GetInputBuffer(index, padded_shape_.data(), dim, dtype);
+  char* dst = static_cast<char*>(buffer->data);
+  if (dev_.device_type != DLDeviceType::kDLCPU) {
+    pad_staging_.resize(padded_bytes);
+    dst = pad_staging_.data();
+  }
+  // Padding is zeros, models which need to tell padding apart take a mask input.
+  std::memset(dst, 0, padded_bytes);
+  CopyRegion(static_cast<const char*>(input), shape, dst, padded_shape_.data(), dim, elem_bytes);
+  if (dev_.device_type != DLDeviceType::kDLCPU) {
+    buffer.CopyFromBytes(dst, padded_bytes);
+  }
+  inputs_[index] = buffer;
+  unpadded_shapes_[index].assign(shape, shape + dim);
+  return true;
+}
+
+bool RelayVMModel::CanInputZeroCopy(int index, const DLTensor* tensor) {
+  const DLDataType dtype = GetInputDLDataType(index);
+  const std::vector<int64_t>& expected_shape = input_shapes_[index];
+  if (reinterpret_cast<size_t>(tensor->data) % tvm::runtime::kAllocAlignment != 0 ||
+      tensor->byte_offset != 0 || tensor->strides != nullptr ||
+      tensor->device.device_type != dev_.device_type ||
+      tensor->device.device_id != dev_.device_id || !TypeEqual(tensor->dtype, dtype) ||
+      static_cast<size_t>(tensor->ndim) != expected_shape.size()) {
+    return false;
+  }
+  for (int i = 0; i < tensor->ndim; i++) {
+    if (expected_shape[i] >= 0 && expected_shape[i] != tensor->shape[i]) return false;
+  }
+  return true;
+}
+
+bool RelayVMModel::SetInputZeroCopy(int index, const DLTensor* tensor) {
+  if (!CanInputZeroCopy(index, tensor)) return false;
+  // The NDArray only references the caller's memory, the deleter frees the DLPack wrapper.
+  DLManagedTensor* managed = new DLManagedTensor();
+  managed->dl_tensor = *tensor;
+  managed->manager_ctx = nullptr;
+  managed->deleter = [](DLManagedTensor* self) { delete self; };
+  inputs_[index] = tvm::runtime::NDArray::FromDLPack(managed);
+  unpadded_shapes_[index].clear();
+  return true;
+}
+
+bool RelayVMModel::BindInputZeroCopy(int index, const tvm::runtime::NDArray& array) {
+#ifdef ENABLE_DATATRANSFORM
+  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) return false;
+#endif
+  CHECK(index >= 0 && index < num_inputs_) << "Input index is out of range.";
+  // Inputs may need padding up to a shape bucket, which takes a copy.
+  if (!shape_buckets_.empty() || !CanInputZeroCopy(index, array.operator->())) return false;
+  // Holding the array keeps its data alive, even once its owner moved on to another buffer.
+  inputs_[index] = array;
+  unpadded_shapes_[index].clear();
+  return true;
+}
+
 void RelayVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
 // Handle string input.
 #ifdef ENABLE_DATATRANSFORM
@@ -330,48 +543,112 @@ void RelayVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
 
   int index = GetInputIndex(name);
   if (index > -1) {
-    std::vector<int64_t> arr_shape(tensor->shape, tensor->shape + tensor->ndim);
-    tvm::runtime::NDArray input_arr = tvm::runtime::NDArray::Empty(arr_shape, tensor->dtype, dev_);
-    input_arr.CopyFrom(tensor);
-    inputs_[index] = input_arr;
+    inputs_[index] = GetInputBuffer(index, tensor->shape, tensor->ndim, tensor->dtype);
+    inputs_[index].CopyFrom(tensor);
+    unpadded_shapes_[index].clear();
   }
 }
 
+void RelayVMModel::SetInputTensorZeroCopy(const char* name, DLTensor* tensor) {
+#ifdef ENABLE_DATATRANSFORM
+  CHECK(!(HasMetadata() && data_transform_.HasInputTransform(metadata_)))
+      << "Input transforms are not supported with SetDLRInputTensorZeroCopy.";
+#endif
+  int index = GetInputIndex(name);
+  if (index == -1) return;
+  CHECK_EQ(reinterpret_cast<size_t>(tensor->data) % tvm::runtime::kAllocAlignment, 0)
+      << "Data must be aligned to " << tvm::runtime::kAllocAlignment
+      << " bytes for SetDLRInputTensorZeroCopy.";
+  CHECK(tensor->device.device_type == dev_.device_type &&
+        tensor->device.device_id == dev_.device_id)
+      << "The input data must be on device \"" << GetStringFromDeviceType(dev_.device_type)
+      << "\", but user gave input on \"" << GetStringFromDeviceType(tensor->device.device_type)
+      << "\"";
+  CHECK(SetInputZeroCopy(index, tensor))
+      << "Input " << name << " does not match the type or shape expected by the model.";
+}
+
 void RelayVMModel::UpdateInputs() {
-  const size_t num_args = num_inputs_ + 1;
-  std::vector<TVMValue> values(num_args);
-  std::vector<int> type_codes(num_args);
-  tvm::runtime::TVMArgsSetter arg_setter(values.data(), type_codes.data());
+  tvm::runtime::TVMArgsSetter arg_setter(input_values_.data(), input_type_codes_.data());
   arg_setter(0, ENTRY_FUNCTION);
   for (int i = 0; i < inputs_.size(); i++) {
     arg_setter(i + 1, inputs_[i]);
   }
-
-  tvm::runtime::PackedFunc set_input = vm_module_->GetFunction("set_input");
   tvm::runtime::TVMRetValue rv;
-  set_input.CallPacked(tvm::runtime::TVMArgs(values.data(), type_codes.data(), num_args), &rv);
+  set_input_.CallPacked(tvm::runtime::TVMArgs(input_values_.data(), input_type_codes_.data(),
+                                              static_cast<int>(input_values_.size())),
+                        &rv);
 }
 
 void RelayVMModel::Run() {
   // Invoke inference
   UpdateInputs();
-  tvm::runtime::PackedFunc invoke = vm_module_->GetFunction("invoke");
-  output_ref_ = invoke(ENTRY_FUNCTION);
+  output_ref_ = invoke_(ENTRY_FUNCTION);
   UpdateOutputs();
+  for (size_t i = 0; i < copy_outputs_.size(); ++i) {
+    DLTensor& bound = copy_outputs_[i];
+    if (bound.data == nullptr) continue;
+    CHECK(std::equal(bound.shape, bound.shape + bound.ndim, outputs_[i]->shape,
+                     outputs_[i]->shape + outputs_[i]->ndim))
+        << "Shape of output #" << i << " does not match the tensor bound to it.";
+    outputs_[i].CopyTo(&bound);
+  }
+}
+
+void RelayVMModel::SetOutputTensorCopy(int index, DLTensor* tensor) {
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+#ifdef ENABLE_DATATRANSFORM
+  CHECK(!(HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)))
+      << "Output transforms are not supported with SetDLROutputTensorZeroCopy.";
+#endif
+  copy_outputs_.resize(num_outputs_, DLTensor{});
+  copy_output_shapes_.resize(num_outputs_);
+  if (tensor == nullptr) {
+    copy_outputs_[index] = DLTensor{};
+    return;
+  }
+  CHECK_EQ(reinterpret_cast<size_t>(tensor->data) % tvm::runtime::kAllocAlignment, 0)
+      << "Data must be aligned to " << tvm::runtime::kAllocAlignment
+      << " bytes for SetDLROutputTensorZeroCopy.";
+  CHECK(tensor->byte_offset == 0 && tensor->strides == nullptr)
+      << "Output tensor must be compact, without byte offset.";
+  const DLDevice& device = tensor->device;
+  CHECK(device.device_type == kDLCPU ||
+        (device.device_type == dev_.device_type && device.device_id == dev_.device_id))
+      << "The output data must be on device \"" << GetStringFromDeviceType(dev_.device_type)
+      << "\" or on the CPU, but user gave output on \""
+      << GetStringFromDeviceType(device.device_type) << "\"";
+  CHECK(TypeEqual(tensor->dtype, tvm::runtime::String2DLDataType(output_types_[index])))
+      << "Output type mismatch, expected " << output_types_[index];
+  const std::vector<int64_t>& expected_shape = output_shapes_[index];
+  CHECK_EQ(static_cast<size_t>(tensor->ndim), expected_shape.size())
+      << "Model expected " << expected_shape.size() << " dimensions, but output has "
+      << tensor->ndim;
+  for (int i = 0; i < tensor->ndim; ++i) {
+    // Dynamic dimensions are checked after each run.
+    if (expected_shape[i] >= 0) CHECK_EQ(expected_shape[i], tensor->shape[i]);
+  }
+  // Keep a copy, the caller's DLTensor may not outlive this call.
+  copy_output_shapes_[index].assign(tensor->shape, tensor->shape + tensor->ndim);
+  copy_outputs_[index] = *tensor;
+  copy_outputs_[index].shape = copy_output_shapes_[index].data();
 }
 
 void RelayVMModel::UpdateOutputs() {
+  // Stays empty until the first run, output shapes come from metadata until then.
   outputs_.resize(num_outputs_);
-  if (output_ref_->IsInstance<tvm::runtime::ADTObj>()) {
-    auto adt = tvm::runtime::Downcast<tvm::runtime::ADT>(output_ref_);
-    for (int i = 0; i < adt.size(); i++) {
-      outputs_[i] = tvm::runtime::Downcast<tvm::runtime::NDArray>(adt[i]);
+  if (const auto* adt = output_ref_.as<tvm::runtime::ADTObj>()) {
+    for (size_t i = 0; i < adt->size; i++) {
+      outputs_[i] = tvm::runtime::Downcast<tvm::runtime::NDArray>((*adt)[i]);
     }
   } else if (output_ref_->IsInstance<tvm::runtime::NDArray::ContainerType>()) {
     outputs_[0] = tvm::runtime::Downcast<tvm::runtime::NDArray>(output_ref_);
   } else {
     throw dmlc::Error("Invalid output_ref format!");
   }
+  if (!shape_buckets_.empty()) {
+    SliceOutputs();
+  }
 // Apply DataTransform if needed.
 #ifdef ENABLE_DATATRANSFORM
   for (size_t i = 0; i < outputs_.size(); ++i) {
@@ -382,6 +659,35 @@ void RelayVMModel::UpdateOutputs() {
 #endif
 }
 
+void RelayVMModel::SliceOutputs() {
+  // Padded length and the length given by the caller, for each padded input dimension.
+  std::vector<std::pair<int64_t, int64_t>> padded_lengths;
+  for (int i = 0; i < num_inputs_; i++) {
+    if (unpadded_shapes_[i].empty()) continue;
+    for (int d = 0; d < inputs_[i]->ndim; d++) {
+      if (inputs_[i]->shape[d] != unpadded_shapes_[i][d]) {
+        padded_lengths.emplace_back(inputs_[i]->shape[d], unpadded_shapes_[i][d]);
+      }
+    }
+  }
+  if (padded_lengths.empty()) return;
+
+  const DLDevice cpu = {DLDeviceType::kDLCPU, 0};
+  for (int i = 0; i < num_outputs_; i++) {
+    tvm::runtime::NDArray out = outputs_[i];
+    std::vector<int64_t> shape(out->shape, out->shape + out->ndim);
+    if (!GetSlicedOutputShape(output_shapes_[i], padded_lengths, &shape)) continue;
+    if (out->device.device_type != DLDeviceType::kDLCPU) out = out.CopyTo(cpu);
+    tvm::runtime::NDArray result =
+        GetCachedBuffer(&output_buffers_[i], shape.data(), out->ndim, out->dtype, cpu,
+                        kMaxInputBuffers);
+    CopyRegion(static_cast<const char*>(out->data) + out->byte_offset, out->shape,
+               static_cast<char*>(result->data), result->shape, out->ndim,
+               (out->dtype.bits * out->dtype.lanes + 7) / 8);
+    outputs_[i] = result;
+  }
+}
+
 void RelayVMModel::GetOutput(int index, void* output) {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
   auto out_array = outputs_[index];
@@ -403,6 +709,26 @@ void RelayVMModel::GetOutput(int index, void* output) {
   out_array.CopyTo(&output_tensor);
 }
 
+tvm::runtime::NDArray RelayVMModel::GetOutputNDArray(int index) const {
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+#ifdef ENABLE_DATATRANSFORM
+  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+    return tvm::runtime::NDArray();
+  }
+#endif
+  return outputs_[index];
+}
+
+tvm::runtime::NDArray RelayVMModel::GetInputNDArray(int index) const {
+  CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+#ifdef ENABLE_DATATRANSFORM
+  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) {
+    return tvm::runtime::NDArray();
+  }
+#endif
+  return inputs_[index];
+}
+
 const void* RelayVMModel::GetOutputPtr(int index) const {
   CHECK_LT(index, num_outputs_) << "Output index is out of range.";
 #ifdef ENABLE_DATATRANSFORM
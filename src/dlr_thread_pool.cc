@@ -0,0 +1,85 @@
+#include "dlr_thread_pool.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace dlr;
+
+ThreadPool::ThreadPool(int num_threads) {
+  if (num_threads < 1) num_threads = 1;
+  for (int i = 0; i < num_threads; i++) {
+    workers_.emplace_back(&ThreadPool::WorkerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::WorkerLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      // Drain remaining tasks before exiting so no future is left without a result.
+      if (stop_ && tasks_.empty()) return;
+      task = std::move(tasks_.front());
+      tasks_.pop();
+    }
+    task();
+  }
+}
+
+ThreadPool& ThreadPool::Global() {
+  static ThreadPool pool([]() {
+    const char* val = std::getenv("DLR_NUM_ASYNC_THREADS");
+    return val ? std::atoi(val) : 2;
+  }());
+  return pool;
+}
+
+void ThreadPool::ParallelFor(size_t num_items, const std::function<void(size_t, size_t)>& fn) {
+  const size_t num_chunks = std::min(num_items, static_cast<size_t>(GetNumThreads()) + 1);
+  if (num_chunks <= 1) {
+    if (num_items > 0) fn(0, num_items);
+    return;
+  }
+  const size_t chunk = (num_items + num_chunks - 1) / num_chunks;
+  std::vector<std::future<void>> futures;
+  for (size_t begin = chunk; begin < num_items; begin += chunk) {
+    const size_t end = std::min(begin + chunk, num_items);
+    futures.push_back(Submit([&fn, begin, end]() { fn(begin, end); }));
+  }
+  // Wait for every range even on failure, the tasks reference fn.
+  std::exception_ptr error;
+  try {
+    fn(0, chunk);
+  } catch (...) {
+    error = std::current_exception();
+  }
+  for (std::future<void>& future : futures) {
+    try {
+      future.get();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+ThreadPool& ThreadPool::Compute() {
+  static ThreadPool pool([]() {
+    const char* val = std::getenv("DLR_NUM_COMPUTE_THREADS");
+    if (val) return std::atoi(val);
+    return static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  }());
+  return pool;
+}
@@ -1,11 +1,113 @@
 #include "dlr_treelite.h"
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <fstream>
+#include <limits>
+
+#if defined(__AVX__) || defined(__SSE2__)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "dlr_thread_pool.h"
 
 using namespace dlr;
 
+namespace {
+
+inline bool KeepValue(float value, bool skip_zero) {
+  return !std::isnan(value) && !(skip_zero && value == 0.0f);
+}
+
+// KeepMask returns a bit per element of a block of kMaskWidth values, set if the value is
+// stored in the CSR matrix, i.e. it is not NAN and not a skipped zero.
+#if defined(__AVX__)
+const size_t kMaskWidth = 8;
+inline uint32_t KeepMask(const float* values, bool skip_zero) {
+  const __m256 v = _mm256_loadu_ps(values);
+  __m256 keep = _mm256_cmp_ps(v, v, _CMP_ORD_Q);
+  if (skip_zero) {
+    keep = _mm256_and_ps(keep, _mm256_cmp_ps(v, _mm256_setzero_ps(), _CMP_NEQ_OQ));
+  }
+  return static_cast<uint32_t>(_mm256_movemask_ps(keep));
+}
+#elif defined(__SSE2__)
+const size_t kMaskWidth = 4;
+inline uint32_t KeepMask(const float* values, bool skip_zero) {
+  const __m128 v = _mm_loadu_ps(values);
+  __m128 keep = _mm_cmpord_ps(v, v);
+  if (skip_zero) keep = _mm_and_ps(keep, _mm_cmpneq_ps(v, _mm_setzero_ps()));
+  return static_cast<uint32_t>(_mm_movemask_ps(keep));
+}
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+const size_t kMaskWidth = 4;
+inline uint32_t KeepMask(const float* values, bool skip_zero) {
+  const float32x4_t v = vld1q_f32(values);
+  uint32x4_t keep = vceqq_f32(v, v);
+  if (skip_zero) keep = vandq_u32(keep, vmvnq_u32(vceqzq_f32(v)));
+  const uint32_t bits[4] = {1, 2, 4, 8};
+  return vaddvq_u32(vandq_u32(keep, vld1q_u32(bits)));
+}
+#else
+const size_t kMaskWidth = 1;
+inline uint32_t KeepMask(const float* values, bool skip_zero) {
+  return KeepValue(*values, skip_zero) ? 1 : 0;
+}
+#endif
+const uint32_t kFullMask = (1u << kMaskWidth) - 1;
+
+inline size_t PopCount(uint32_t mask) {
+  size_t count = 0;
+  for (; mask != 0; mask &= mask - 1) ++count;
+  return count;
+}
+
+/*! \brief Count the values of a row that are stored in the CSR matrix. */
+size_t CountRowValues(const float* row, size_t num_col, bool skip_zero) {
+  size_t count = 0;
+  size_t j = 0;
+  for (; j + kMaskWidth <= num_col; j += kMaskWidth) {
+    count += PopCount(KeepMask(row + j, skip_zero));
+  }
+  for (; j < num_col; ++j) {
+    count += KeepValue(row[j], skip_zero);
+  }
+  return count;
+}
+
+/*! \brief Write the values of a row that are stored in the CSR matrix with their columns. */
+void ScatterRowValues(const float* row, uint32_t num_col, bool skip_zero, float* data,
+                      uint32_t* col_ind) {
+  uint32_t j = 0;
+  for (; j + kMaskWidth <= num_col; j += kMaskWidth) {
+    const uint32_t mask = KeepMask(row + j, skip_zero);
+    if (mask == kFullMask) {
+      for (uint32_t k = 0; k < kMaskWidth; ++k) {
+        *data++ = row[j + k];
+        *col_ind++ = j + k;
+      }
+    } else {
+      for (uint32_t k = 0; k < kMaskWidth; ++k) {
+        if (mask & (1u << k)) {
+          *data++ = row[j + k];
+          *col_ind++ = j + k;
+        }
+      }
+    }
+  }
+  for (; j < num_col; ++j) {
+    if (KeepValue(row[j], skip_zero)) {
+      *data++ = row[j];
+      *col_ind++ = j;
+    }
+  }
+}
+
+}  // namespace
+
 const std::string TreeliteModel::INPUT_NAME = "data";
 const std::string TreeliteModel::INPUT_TYPE = "float32";
 const std::string TreeliteModel::OUTPUT_TYPE = "float32";
@@ -40,11 +142,13 @@ ModelPath dlr::SetTreelitePaths(const std::vector<std::string>& files) {
   return paths;
 }
 
-TreeliteInput::~TreeliteInput() {
+void TreeliteInput::FreeHandle() {
   if (handle != nullptr) TreeliteDMatrixFree(handle);
   handle = nullptr;
 }
 
+TreeliteInput::~TreeliteInput() { FreeHandle(); }
+
 void TreeliteModel::SetupTreeliteModule(const std::vector<std::string>& model_path) {
   ModelPath paths = SetTreelitePaths(model_path);
   // If OMP_NUM_THREADS is set, use it to determine number of threads;
@@ -146,41 +250,105 @@ void TreeliteModel::SetInput(const char* name, const int64_t* shape, const void*
 
   const size_t batch_size = static_cast<size_t>(shape[0]);
   const uint32_t num_col = static_cast<uint32_t>(shape[1]);
-  treelite_input_.reset(new TreeliteInput);
+  const float* input_f = static_cast<const float*>(input);
+  // Reuse the input buffers of the previous call, only the DMatrix is recreated.
+  if (!treelite_input_) {
+    treelite_input_.reset(new TreeliteInput);
+  }
   CHECK(treelite_input_);
-  treelite_input_->row_ptr.push_back(0);
-  float* input_f = (float*)input;
+  PrepareInput(input_f, batch_size, num_col, treelite_input_.get());
+  UpdateInputShapes();
+}
+
+void TreeliteModel::PrepareInput(const float* input_f, size_t batch_size, uint32_t num_col,
+                                 TreeliteInput* out) {
+  out->FreeHandle();
+  // Dense inputs are registered as they are, which avoids building a CSR copy. CSR is used
+  // when zeros must be skipped, columns are missing, or most of the values are missing.
+  bool use_dense = !has_sparse_input_ && num_col == treelite_num_feature_;
+  if (use_dense) {
+    const size_t num_elem = batch_size * num_col;
+    const size_t num_missing = num_elem - CountRowValues(input_f, num_elem, false);
+    use_dense = num_missing <= kDenseMaxMissingRatio * num_elem;
+  }
+  if (use_dense) {
+    PrepareInputDense(input_f, batch_size, out);
+  } else {
+    PrepareInputCSR(input_f, batch_size, num_col, out);
+  }
+}
+
+void TreeliteModel::PrepareInputDense(const float* input, size_t batch_size, TreeliteInput* out) {
+  // Save dimensions for input
+  out->num_row = batch_size;
+  out->num_col = treelite_num_feature_;
+
+  // Register dense matrix with Treelite backend, NAN marks missing values.
+  const float missing_value = std::numeric_limits<float>::quiet_NaN();
+  CHECK_EQ(TreeliteDMatrixCreateFromMat(input, "float32", batch_size, treelite_num_feature_,
+                                        &missing_value, &out->handle),
+           0)
+      << TreeliteGetLastError();
+}
+
+void TreeliteModel::PrepareInputCSR(const float* input_f, size_t batch_size, uint32_t num_col,
+                                    TreeliteInput* out) {
+  auto& data = out->data;
+  auto& col_ind = out->col_ind;
+  auto& row_ptr = out->row_ptr;
+  const size_t data_capacity = data.capacity();
+  const size_t row_ptr_capacity = row_ptr.capacity();
 
   // NOTE: Assume row-major (C) layout
-  treelite_input_->data.reserve(batch_size * num_col);
-  treelite_input_->col_ind.reserve(batch_size * num_col);
-  treelite_input_->row_ptr.reserve(batch_size);
-  for (size_t i = 0; i < batch_size; ++i) {
-    for (uint32_t j = 0; j < num_col; ++j) {
-      if (std::isnan(input_f[i * num_col + j])) continue;
-      if (has_sparse_input_ && input_f[i * num_col + j] == 0.0f) continue;
-      treelite_input_->data.push_back(input_f[i * num_col + j]);
-      treelite_input_->col_ind.push_back(j);
+  // The CSR matrix is built in two passes over rows: count the stored values of each row, turn
+  // the counts into row_ptr with a prefix sum, then scatter every row to its offset. Both passes
+  // run in parallel on large inputs.
+  row_ptr.resize(batch_size + 1);
+  auto for_rows = [batch_size, num_col](const std::function<void(size_t, size_t)>& fn) {
+    if (batch_size > 1 && batch_size * num_col >= kParallelMinElements) {
+      ThreadPool::Compute().ParallelFor(batch_size, fn);
+    } else {
+      fn(0, batch_size);
     }
-    treelite_input_->row_ptr.push_back(treelite_input_->data.size());
+  };
+  const bool skip_zero = has_sparse_input_;
+  for_rows([&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      row_ptr[i + 1] = CountRowValues(input_f + i * num_col, num_col, skip_zero);
+    }
+  });
+  row_ptr[0] = 0;
+  for (size_t i = 0; i < batch_size; ++i) {
+    row_ptr[i + 1] += row_ptr[i];
   }
+  // Reserve the dense size so the buffers do not grow when the sparsity changes between calls.
+  data.reserve(batch_size * num_col);
+  col_ind.reserve(batch_size * num_col);
+  data.resize(row_ptr[batch_size]);
+  col_ind.resize(row_ptr[batch_size]);
+  if (data.capacity() != data_capacity || row_ptr.capacity() != row_ptr_capacity) {
+    num_buffer_allocations_++;
+  }
+  for_rows([&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      ScatterRowValues(input_f + i * num_col, num_col, skip_zero, data.data() + row_ptr[i],
+                       col_ind.data() + row_ptr[i]);
+    }
+  });
   // Post conditions for CSR matrix initialization
-  CHECK_EQ(treelite_input_->data.size(), treelite_input_->col_ind.size());
-  CHECK_EQ(treelite_input_->data.size(), treelite_input_->row_ptr.back());
-  CHECK_EQ(treelite_input_->row_ptr.size(), batch_size + 1);
+  CHECK_EQ(data.size(), col_ind.size());
+  CHECK_EQ(data.size(), row_ptr.back());
+  CHECK_EQ(row_ptr.size(), batch_size + 1);
 
   // Save dimensions for input
-  treelite_input_->num_row = batch_size;
-  treelite_input_->num_col = treelite_num_feature_;
+  out->num_row = batch_size;
+  out->num_col = treelite_num_feature_;
 
   // Register CSR matrix with Treelite backend
-  CHECK_EQ(
-      TreeliteDMatrixCreateFromCSR(treelite_input_->data.data(), "float32",
-                                   treelite_input_->col_ind.data(), treelite_input_->row_ptr.data(),
-                                   batch_size, treelite_num_feature_, &treelite_input_->handle),
-      0)
+  CHECK_EQ(TreeliteDMatrixCreateFromCSR(data.data(), "float32", col_ind.data(), row_ptr.data(),
+                                        batch_size, treelite_num_feature_, &out->handle),
+           0)
       << TreeliteGetLastError();
-  UpdateInputShapes();
 }
 
 void TreeliteModel::GetInput(const char* name, void* input) {
@@ -220,18 +388,93 @@ const char* TreeliteModel::GetOutputType(int index) const {
 }
 
 void TreeliteModel::Run() {
-  size_t out_result_size;
   CHECK(treelite_input_);
-  treelite_output_.resize(treelite_input_->num_row * treelite_output_buffer_size_);
-  CHECK_EQ(TreelitePredictorPredictBatch(treelite_model_, treelite_input_->handle, 0, pred_margin,
-                                         (PredictorOutputHandle*)treelite_output_.data(),
-                                         &out_result_size),
+  treelite_output_size_ = PredictBatch(treelite_input_.get(), &treelite_output_);
+}
+
+size_t TreeliteModel::PredictBatch(TreeliteInput* input,
+                                   std::vector<float, DLRAllocator<float>>* output) {
+  size_t out_result_size;
+  const size_t output_capacity = output->capacity();
+  output->resize(input->num_row * treelite_output_buffer_size_);
+  if (output->capacity() != output_capacity) {
+    num_buffer_allocations_++;
+  }
+  CHECK_EQ(TreelitePredictorPredictBatch(treelite_model_, input->handle, 0, pred_margin,
+                                         (PredictorOutputHandle*)output->data(), &out_result_size),
            0)
       << TreeliteGetLastError();
   // Treelite model output shape will be know only after the model run
   // If model uses objective multi:softmax then output shape will be (batch, 1)
   // because predictor will execute predictor_transform max_index
-  treelite_output_size_ = out_result_size / treelite_input_->num_row;
+  return out_result_size / input->num_row;
+}
+
+void TreeliteModel::PredictChunks(
+    const std::function<const float*(size_t* num_rows)>& next_chunk,
+    const std::function<void(const float*, size_t, size_t)>& on_output) {
+  size_t num_rows = 0;
+  const float* rows = next_chunk(&num_rows);
+  if (num_rows == 0) return;
+  PrepareInput(rows, num_rows, treelite_num_feature_, &stream_inputs_[0]);
+  if (!stream_worker_) stream_worker_.reset(new ThreadPool(1));
+  for (int k = 0;; k ^= 1) {
+    TreeliteInput* input = &stream_inputs_[k];
+    auto* output = &stream_outputs_[k];
+    std::future<size_t> prediction = stream_worker_->Submit(
+        [this, input, output]() { return PredictBatch(input, output); });
+    // Read and convert the next chunk while the current one is being predicted.
+    try {
+      rows = next_chunk(&num_rows);
+      if (num_rows > 0) {
+        PrepareInput(rows, num_rows, treelite_num_feature_, &stream_inputs_[k ^ 1]);
+      }
+    } catch (...) {
+      prediction.wait();
+      throw;
+    }
+    const size_t row_size = prediction.get();
+    on_output(output->data(), input->num_row, row_size);
+    if (num_rows == 0) break;
+  }
+}
+
+void TreeliteModel::PredictStream(const RowReader& next_rows, const OutputWriter& on_output,
+                                  size_t chunk_rows) {
+  CHECK_GT(chunk_rows, 0) << "chunk_rows must be positive.";
+  const size_t capacity = stream_rows_.capacity();
+  stream_rows_.resize(chunk_rows * treelite_num_feature_);
+  if (stream_rows_.capacity() != capacity) {
+    num_buffer_allocations_++;
+  }
+  // Inputs are copied when converted, so a single staging buffer is enough.
+  PredictChunks(
+      [&](size_t* num_rows) {
+        *num_rows = next_rows(stream_rows_.data(), chunk_rows);
+        CHECK_LE(*num_rows, chunk_rows) << "RowReader returned more rows than requested.";
+        return stream_rows_.data();
+      },
+      on_output);
+}
+
+void TreeliteModel::PredictFile(const std::string& path, const OutputWriter& on_output,
+                                size_t chunk_rows) {
+  CHECK_GT(chunk_rows, 0) << "chunk_rows must be positive.";
+  MemoryMappedFile file(path);
+  const size_t row_bytes = sizeof(float) * treelite_num_feature_;
+  CHECK_EQ(file.GetSize() % row_bytes, 0)
+      << "Size of " << path << " is not a multiple of the row size " << row_bytes << ".";
+  const float* data = reinterpret_cast<const float*>(file.GetData());
+  const size_t total_rows = file.GetSize() / row_bytes;
+  size_t next_row = 0;
+  PredictChunks(
+      [&](size_t* num_rows) {
+        *num_rows = std::min(chunk_rows, total_rows - next_row);
+        const float* rows = data + next_row * treelite_num_feature_;
+        next_row += *num_rows;
+        return rows;
+      },
+      on_output);
 }
 
 void TreeliteModel::SetNumThreads(int threads) {
@@ -1,14 +1,52 @@
 #include "dlr_tvm.h"
 
 #include <stdlib.h>
+#include <dmlc/memory_io.h>
 #include <tvm/runtime/registry.h>
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <exception>
 #include <fstream>
+#include <functional>
+#include <future>
 #include <iterator>
 #include <numeric>
+#include <thread>
+
+#include "dlr_allocator.h"
+#include "dlr_archive.h"
+#include "dlr_thread_pool.h"
 
 using namespace dlr;
 
+/*! \brief Whether TVM binds the threads of its pools to cores, the leading ones first. */
+static bool TVMBindsThreads() {
+  const char* val = std::getenv("TVM_BIND_THREADS");
+  return val == nullptr || std::string(val) != "0";
+}
+
+/*! \brief Threads of a TVM thread pool, as set by TVMModel::SetNumThreads. */
+static int GetTVMNumThreads() {
+  const char* val = std::getenv("TVM_NUM_THREADS");
+  const int num_threads = val != nullptr ? std::atoi(val) : 0;
+  return num_threads > 0 ? num_threads
+                         : std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+/*! \brief Resize the TVM thread pool of the calling thread, if the runtime supports it. */
+static void ConfigureTVMThreads(int num_threads) {
+  thread_local int configured_threads = 0;
+  if (configured_threads == num_threads) return;
+  const tvm::runtime::PackedFunc* config =
+      tvm::runtime::Registry::Get("runtime.config_threadpool");
+  if (config == nullptr) return;
+  // Mode 1 uses the big cores, which is all of them on CPUs with one kind of core.
+  (*config)(1, num_threads);
+  configured_threads = num_threads;
+}
+
 void TVMModel::SetupTVMModule(const std::vector<std::string>& files) {
   ModelPath path;
   dlr::InitModelPath(files, &path);
@@ -18,15 +56,37 @@ void TVMModel::SetupTVMModule(const std::vector<std::string>& files) {
 
   std::vector<DLRModelElem> model_elems = {
       {DLRModelElemType::TVM_GRAPH, path.model_json.c_str(), nullptr, 0},
-      {DLRModelElemType::TVM_PARAMS, path.params.c_str(), nullptr, 0},
+      {GetParamsElemType(), path.params.c_str(), nullptr, 0},
       {DLRModelElemType::TVM_LIB, path.model_lib.c_str(), nullptr, 0}};
   if (!path.metadata.empty()) {
     model_elems.push_back({DLRModelElemType::NEO_METADATA, path.metadata.c_str(), nullptr, 0});
   }
   SetupTVMModule(model_elems);
+  if (HasMetadata() && metadata_.count("Model") && metadata_["Model"].count("BatchVariants")) {
+    LoadBatchVariants(GetParentFolder(path.metadata));
+  }
+}
+
+DLRModelElemType TVMModel::GetParamsElemType() {
+  // Let weights alias the mapped params file, or share them with other models or processes,
+  // if requested.
+  const char* val = std::getenv("DLR_TVM_PARAMS_MMAP");
+  const char* shared_val = std::getenv("DLR_TVM_SHARE_PARAMS");
+  const char* shm_val = std::getenv("DLR_TVM_PARAMS_SHM");
+  if (val != nullptr && std::string(val) == "1") {
+    return DLRModelElemType::TVM_PARAMS_MMAP;
+  } else if (shm_val != nullptr && std::string(shm_val) == "1") {
+    return DLRModelElemType::TVM_PARAMS_SHM;
+  } else if (shared_val != nullptr && std::string(shared_val) == "1") {
+    return DLRModelElemType::TVM_PARAMS_SHARED;
+  }
+  return DLRModelElemType::TVM_PARAMS;
 }
 
-void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems) {
+void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems,
+                              std::shared_ptr<const MemoryMappedFile> backing) {
+  load_phases_.clear();
+  PhaseTimer timer(&load_phases_);
   // Set custom allocators in TVM.
   if (dlr::DLRAllocatorFunctions::GetMemalignFunction() &&
       dlr::DLRAllocatorFunctions::GetFreeFunction()) {
@@ -43,7 +103,8 @@ void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems) {
   }
 
   std::string graph_str;
-  DLRString params_str;
+  std::unique_ptr<MemoryMappedFile> params_file;
+  DLRModelElemType params_type = DLRModelElemType::TVM_PARAMS;
   const char* params_data = nullptr;
   size_t params_size = 0;
   std::string model_lib_path;
@@ -53,18 +114,23 @@ void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems) {
       if (el.path != nullptr) {
         graph_str = dlr::LoadFileToString(el.path);
       } else if (el.data != nullptr) {
-        graph_str = static_cast<const char*>(el.data);
+        // NUL-terminated, or sized like the sections of a model archive.
+        const char* text = static_cast<const char*>(el.data);
+        graph_str = el.data_size > 0 ? std::string(text, el.data_size) : std::string(text);
       } else {
         throw dmlc::Error("Invalid TVM model element TVM_GRAPH");
       }
-    } else if (el.type == DLRModelElemType::TVM_PARAMS) {
+    } else if (el.type == DLRModelElemType::TVM_PARAMS ||
+               el.type == DLRModelElemType::TVM_PARAMS_MMAP ||
+               el.type == DLRModelElemType::TVM_PARAMS_SHARED ||
+               el.type == DLRModelElemType::TVM_PARAMS_SHM) {
+      params_type = el.type;
       if (el.path != nullptr) {
-        std::ifstream pstream(el.path, std::ios::in | std::ios::binary);
-        DLRStringStream params_blob;
-        params_blob << pstream.rdbuf();
-        params_str = params_blob.str();
-        params_data = params_str.data();
-        params_size = params_str.size();
+        // Map the file instead of reading it so the only resident copy of the weights is the
+        // one in the executor (or none at all with TVM_PARAMS_MMAP).
+        params_file.reset(new MemoryMappedFile(el.path));
+        params_data = params_file->GetData();
+        params_size = params_file->GetSize();
       } else if (el.data != nullptr && el.data_size > 0) {
         params_data = static_cast<const char*>(el.data);
         params_size = el.data_size;
@@ -74,14 +140,19 @@ void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems) {
     } else if (el.type == DLRModelElemType::TVM_LIB) {
       if (el.path != nullptr) {
         model_lib_path = el.path;
+      } else if (el.data != nullptr && el.data_size > 0) {
+        lib_memory_ = std::make_shared<InMemoryLibrary>(el.data, el.data_size);
+        model_lib_path = lib_memory_->GetPath();
       } else {
-        throw dmlc::Error("Invalid TVM model element TVM_LIB. TVM_LIB must be a file path.");
+        throw dmlc::Error("Invalid TVM model element TVM_LIB");
       }
     } else if (el.type == DLRModelElemType::NEO_METADATA) {
       if (el.path != nullptr) {
         metadata_data = dlr::LoadFileToString(el.path);
       } else if (el.data != nullptr) {
-        metadata_data = static_cast<const char*>(el.data);
+        // NUL-terminated, or sized like the sections of a model archive.
+        const char* text = static_cast<const char*>(el.data);
+        metadata_data = el.data_size > 0 ? std::string(text, el.data_size) : std::string(text);
       }
     }
   }
@@ -92,19 +163,601 @@ void TVMModel::SetupTVMModule(const std::vector<DLRModelElem>& model_elems) {
     LoadJsonFromString(metadata_data, this->metadata_);
     ValidateDeviceTypeIfExists();
   }
+  timer.Mark("read_elements");
 
-  tvm::runtime::Module module;
-  module = tvm::runtime::Module::LoadFromFile(model_lib_path);
+  graph_json_ = std::make_shared<const std::string>(std::move(graph_str));
+  lib_path_ = model_lib_path;
+  // The path of an in-memory library has no extension to tell its format.
+  tvm_lib_ = tvm::runtime::Module::LoadFromFile(model_lib_path, lib_memory_ ? "so" : "");
+  timer.Mark("load_library");
 
   tvm_graph_executor_ = tvm::runtime::make_object<tvm::runtime::GraphExecutor>();
-  tvm_graph_executor_->Init(graph_str, module, {dev_}, nullptr);
-  dmlc::MemoryFixedSizeStream strm(const_cast<char*>(params_data), params_size);
-  tvm_graph_executor_->LoadParams(&strm);
+  tvm_graph_executor_->Init(*graph_json_, tvm_lib_, {dev_}, nullptr);
+  timer.Mark("init_executor");
+  // All modes but TVM_PARAMS read the blob in place, which needs it in the executor's byte
+  // order. A snapshot holds the weights in their final layout, so it is aliased in place
+  // whenever its mapping can be kept.
+  const bool snapshot = IsParamsSnapshot(params_data, params_size);
+  if (snapshot && params_type == DLRModelElemType::TVM_PARAMS && (params_file || backing)) {
+    params_type = DLRModelElemType::TVM_PARAMS_MMAP;
+  }
+  bool params_loaded = false;
+  if (IsCompressedParams(params_data, params_size)) {
+    if (params_type != DLRModelElemType::TVM_PARAMS) {
+      LOG(WARNING) << "Compressed params are decompressed into the executor, they are not "
+                      "mapped or shared.";
+    }
+    LoadParamsCompressed(params_data, params_size);
+    params_loaded = true;
+  } else if (DMLC_IO_NO_ENDIAN_SWAP && params_type != DLRModelElemType::TVM_PARAMS) {
+    mapped_params_ = std::make_shared<TVMMappedParams>();
+    if (params_type == DLRModelElemType::TVM_PARAMS_MMAP && dev_.device_type == kDLCPU) {
+      if (params_file) {
+        mapped_params_->file = std::move(params_file);
+      } else {
+        mapped_params_->file = std::move(backing);
+      }
+      LoadParamsZeroCopy(params_data, params_size);
+      params_loaded = true;
+    } else if (params_type == DLRModelElemType::TVM_PARAMS_SHARED) {
+      LoadParamsShared(params_data, params_size);
+      params_loaded = true;
+    } else if (params_type == DLRModelElemType::TVM_PARAMS_SHM && dev_.device_type == kDLCPU) {
+      params_loaded = LoadParamsSharedMemory(params_data, params_size);
+    }
+    if (!params_loaded) mapped_params_.reset();
+  }
+  if (!params_loaded && snapshot) {
+    LoadParamsCopy(params_data, params_size);
+  } else if (!params_loaded) {
+    dmlc::MemoryFixedSizeStream strm(const_cast<char*>(params_data), params_size);
+    tvm_graph_executor_->LoadParams(&strm);
+    weight_names_ = tvm_graph_executor_->GetWeightNames();
+  }
+  timer.Mark("load_params");
+
+  FetchExecutorData();
+  timer.Mark("fetch_executor_data");
+}
+
+TVMMappedParams::~TVMMappedParams() {
+  for (const tvm::runtime::NDArray& array : shared) ParamStore::Global().Release(array);
+}
+
+void TVMModel::LoadParamsZeroCopy(const char* params_data, size_t params_size) {
+  // Bind each weight to the executor in place. Weights whose data is not aligned as the
+  // executor requires are copied.
+  weight_names_ = ForEachParam(
+      params_data, params_size,
+      [this](const std::string& name, std::vector<int64_t>* shape, DLTensor* tensor) {
+        const int index = tvm_graph_executor_->GetInputIndex(name);
+        if (index < 0) return;
+        if (reinterpret_cast<size_t>(tensor->data) % tvm::runtime::kAllocAlignment == 0) {
+          mapped_params_->params.push_back({index, std::move(*shape), *tensor});
+          TVMMappedParam& param = mapped_params_->params.back();
+          param.tensor.shape = param.shape.data();
+        } else {
+          tvm_graph_executor_->SetInput(index, tensor);
+        }
+      });
+  BindMappedParams();
+}
+
+void TVMModel::LoadParamsCopy(const char* params_data, size_t params_size) {
+  weight_names_ = ForEachParam(
+      params_data, params_size,
+      [this](const std::string& name, std::vector<int64_t>* shape, DLTensor* tensor) {
+        const int index = tvm_graph_executor_->GetInputIndex(name);
+        if (index >= 0) tvm_graph_executor_->SetInput(index, tensor);
+      });
+}
+
+void TVMModel::LoadParamsShared(const char* params_data, size_t params_size) {
+  // Bind each weight to the copy in the process-wide store, shared with every other model
+  // holding a weight of the same contents.
+  weight_names_ = ForEachParam(
+      params_data, params_size,
+      [this](const std::string& name, std::vector<int64_t>* shape, DLTensor* tensor) {
+        const int index = tvm_graph_executor_->GetInputIndex(name);
+        if (index < 0) return;
+        tvm::runtime::NDArray array = ParamStore::Global().Acquire(*tensor, dev_);
+        mapped_params_->shared.push_back(array);
+        mapped_params_->params.push_back({index, std::move(*shape), *array.operator->()});
+        TVMMappedParam& param = mapped_params_->params.back();
+        param.tensor.shape = param.shape.data();
+      });
+  BindMappedParams();
+}
+
+bool TVMModel::LoadParamsSharedMemory(const char* params_data, size_t params_size) {
+  // The segment holds every weight of the blob, not only those of this graph, in blob order at
+  // aligned offsets. Its layout thus depends on the blob alone, which the name is derived from.
+  std::vector<std::pair<const char*, size_t>> weights;
+  std::vector<size_t> offsets;
+  size_t segment_size = 0;
+  ForEachParam(params_data, params_size,
+               [&](const std::string&, std::vector<int64_t>*, DLTensor* tensor) {
+                 const size_t size = tvm::runtime::GetDataSize(*tensor);
+                 weights.emplace_back(static_cast<const char*>(tensor->data), size);
+                 offsets.push_back(segment_size);
+                 const size_t align = tvm::runtime::kAllocAlignment;
+                 segment_size += (size + align - 1) / align * align;
+               });
+  const std::string segment_name = GetSharedParamsName(params_data, params_size);
+  mapped_params_->segment =
+      SharedMemorySegment::OpenOrCreate(segment_name, segment_size, [&](char* data) {
+        for (size_t i = 0; i < weights.size(); i++) {
+          std::memcpy(data + offsets[i], weights[i].first, weights[i].second);
+        }
+      });
+  if (!mapped_params_->segment) {
+    LOG(WARNING) << "Weights are not shared across processes, loading a private copy.";
+    return false;
+  }
+
+  // The name only identifies the blob by hash. The weights are bound only if they match the
+  // blob, a segment which does not is removed so the next process creates it again.
+  const char* segment_data = mapped_params_->segment->GetData();
+  for (size_t i = 0; i < weights.size(); i++) {
+    if (std::memcmp(segment_data + offsets[i], weights[i].first, weights[i].second) != 0) {
+      LOG(WARNING) << "Shared memory segment " << segment_name
+                   << " does not match the weights, loading a private copy.";
+      mapped_params_->segment.reset();
+      SharedMemorySegment::Remove(segment_name);
+      return false;
+    }
+  }
+  size_t i = 0;
+  weight_names_ = ForEachParam(
+      params_data, params_size,
+      [&](const std::string& name, std::vector<int64_t>* shape, DLTensor* tensor) {
+        const size_t offset = offsets[i++];
+        const int index = tvm_graph_executor_->GetInputIndex(name);
+        if (index < 0) return;
+        // Executors only read weights, the read-only mapping is never written.
+        tensor->data = const_cast<char*>(segment_data + offset);
+        mapped_params_->params.push_back({index, std::move(*shape), *tensor});
+        TVMMappedParam& param = mapped_params_->params.back();
+        param.tensor.shape = param.shape.data();
+      });
+  BindMappedParams();
+  return true;
+}
+
+void TVMModel::LoadParamsCompressed(const char* params_data, size_t params_size) {
+  // Each weight is decompressed straight into the executor's array, on CPU, by all compute
+  // threads taking the next weight in turn. Largest weights go first so threads finish together.
+  std::vector<CompressedParam> params = ReadCompressedParams(params_data, params_size);
+  std::vector<std::pair<const CompressedParam*, tvm::runtime::NDArray>> weights;
+  for (const CompressedParam& param : params) {
+    weight_names_.push_back(param.name);
+    const int index = tvm_graph_executor_->GetInputIndex(param.name);
+    if (index < 0) continue;
+    tvm::runtime::NDArray array = tvm_graph_executor_->GetInput(index);
+    const DLTensor* expected = array.operator->();
+    CHECK(expected->dtype.code == param.dtype.code && expected->dtype.bits == param.dtype.bits &&
+          expected->dtype.lanes == param.dtype.lanes)
+        << "Type of weight " << param.name << " does not match the graph.";
+    CHECK(static_cast<size_t>(expected->ndim) == param.shape.size() &&
+          std::equal(param.shape.begin(), param.shape.end(), expected->shape))
+        << "Shape of weight " << param.name << " does not match the graph.";
+    CHECK_EQ(tvm::runtime::GetDataSize(*expected), param.size)
+        << "Size of weight " << param.name << " does not match the graph.";
+    weights.emplace_back(&param, array);
+  }
+  std::sort(weights.begin(), weights.end(), [](const auto& a, const auto& b) {
+    return a.first->size > b.first->size;
+  });
+  std::atomic<size_t> next{0};
+  const bool on_host = dev_.device_type == kDLCPU;
+  ThreadPool::Compute().ParallelFor(weights.size(), [&](size_t, size_t) {
+    std::vector<char> staging;
+    for (size_t i = next++; i < weights.size(); i = next++) {
+      const CompressedParam& param = *weights[i].first;
+      tvm::runtime::NDArray& array = weights[i].second;
+      if (on_host) {
+        DecompressParam(param, static_cast<char*>(array->data) + array->byte_offset);
+      } else {
+        staging.resize(param.size);
+        DecompressParam(param, staging.data());
+        array.CopyFromBytes(staging.data(), param.size);
+      }
+    }
+  });
+}
+
+void TVMModel::BindMappedParams() {
+  if (!mapped_params_) return;
+  for (TVMMappedParam& param : mapped_params_->params) {
+    tvm_graph_executor_->SetInputZeroCopy(param.input_index, &param.tensor);
+  }
+}
+
+bool TVMModel::HasBatchDim() const {
+  // Batches are split and joined along the first dimension of every input and output.
+  if (num_inputs_ == 0 || input_shapes_[0].empty()) return false;
+  const int64_t batch_size = input_shapes_[0][0];
+  for (const std::vector<int64_t>& shape : input_shapes_) {
+    if (shape.empty() || shape[0] != batch_size) return false;
+  }
+  for (const tvm::runtime::NDArray& output : outputs_) {
+    if (output->ndim < 1 || output->shape[0] != batch_size) return false;
+  }
+  return true;
+}
+
+void TVMModel::InitBatchVariants() {
+#ifdef ENABLE_DATATRANSFORM
+  CHECK(!(HasMetadata() && data_transform_.HasInputTransform(metadata_)))
+      << "Input transforms are not supported with batch variants.";
+  for (int i = 0; i < num_outputs_; i++) {
+    CHECK(!(HasMetadata() && data_transform_.HasOutputTransform(metadata_, i)))
+        << "Output transforms are not supported with batch variants.";
+  }
+#endif
+  CHECK_GT(num_inputs_, 0) << "Batch variants require a model with inputs.";
+  CHECK(HasBatchDim()) << "Batch variants require the graph's batch size as first dimension of "
+                          "every input and output.";
+  CHECK(zero_copy_outputs_.empty() && bound_inputs_.empty())
+      << "Batch variants are not supported with zero-copy outputs or prepared bindings.";
+  const char* val = std::getenv("DLR_TVM_BATCH_CONTEXTS");
+  if (val != nullptr) num_batch_contexts_ = std::max(1, std::atoi(val));
+  if (num_batch_contexts_ > 1 && TVMBindsThreads()) {
+    LOG(WARNING) << "Batch contexts run TVM thread pools bound to the same cores, set "
+                    "TVM_BIND_THREADS=0 to share the cores between them.";
+  }
 
+  TVMBatchVariant own;
+  own.batch_size = input_shapes_[0][0];
+  own.graph_json = graph_json_;
+  own.lib = tvm_lib_;
+  own.executors.push_back(tvm_graph_executor_);
+  for (int i = 0; i < num_inputs_; i++) {
+    own.input_indices.push_back(tvm_graph_executor_->GetInputIndex(input_names_[i]));
+  }
+  // Inputs set so far carry over as batches of the graph's size.
+  batch_input_rows_.assign(num_inputs_, own.batch_size);
+  batch_inputs_.resize(num_inputs_);
+  for (int i = 0; i < num_inputs_; i++) {
+    ResetGraphInputZeroCopy(own.input_indices[i]);
+    tvm::runtime::NDArray arr = tvm_graph_executor_->GetInput(own.input_indices[i]);
+    batch_inputs_[i].resize(tvm::runtime::GetDataSize(*arr.operator->()));
+    arr.CopyToBytes(batch_inputs_[i].data(), batch_inputs_[i].size());
+  }
+  batch_outputs_.resize(num_outputs_);
+  batch_staging_.resize(num_batch_contexts_);
+  batch_variants_.push_back(std::move(own));
+}
+
+tvm::runtime::ObjectPtr<tvm::runtime::GraphExecutor> TVMModel::CreateSharedExecutor(
+    const TVMBatchVariant& variant) {
+  auto executor = tvm::runtime::make_object<tvm::runtime::GraphExecutor>();
+  // Init allocates storage for every entry of the graph, weights included. That storage is
+  // not used, weights are read from this model, aliased params taking precedence over the
+  // executor's own buffers.
+  executor->Init(*variant.graph_json, variant.lib, {dev_}, nullptr);
+  std::unordered_map<int, const DLTensor*> mapped;
+  if (mapped_params_) {
+    for (const TVMMappedParam& param : mapped_params_->params) {
+      mapped[param.input_index] = &param.tensor;
+    }
+  }
+  for (const std::string& name : weight_names_) {
+    const int own_index = tvm_graph_executor_->GetInputIndex(name);
+    if (own_index < 0) continue;
+    const int index = executor->GetInputIndex(name);
+    CHECK_GE(index, 0) << "Weight " << name << " not found in batch variant.";
+    // The executor of this model keeps the weight alive.
+    const DLTensor* weight = mapped.count(own_index)
+                                 ? mapped[own_index]
+                                 : tvm_graph_executor_->GetInput(own_index).operator->();
+    executor->SetInputZeroCopy(index, const_cast<DLTensor*>(weight));
+  }
+  return executor;
+}
+
+void TVMModel::LoadBatchVariants(const std::string& model_dir) {
+  InitBatchVariants();
+  for (const auto& entry : metadata_["Model"]["BatchVariants"]) {
+    const std::string rel_path = entry.get<std::string>();
+    const std::string dir = rel_path[0] == '/' ? rel_path : model_dir + "/" + rel_path;
+    ModelPath path;
+    dlr::InitModelPath(FindFiles({dir}), &path);
+    if (path.model_json.empty() || path.model_lib.empty()) {
+      throw dmlc::Error("Invalid batch variant " + dir + ". Must have .so and .json files.");
+    }
+    TVMBatchVariant variant;
+    variant.graph_json = std::make_shared<const std::string>(LoadFileToString(path.model_json));
+    variant.lib = tvm::runtime::Module::LoadFromFile(path.model_lib);
+    variant.executors.push_back(CreateSharedExecutor(variant));
+    tvm::runtime::GraphExecutor& executor = *variant.executors[0];
+    for (int i = 0; i < num_inputs_; i++) {
+      variant.input_indices.push_back(executor.GetInputIndex(input_names_[i]));
+      CHECK_GE(variant.input_indices[i], 0)
+          << "Input " << input_names_[i] << " not found in batch variant " << dir;
+      tvm::runtime::NDArray arr = executor.GetInput(variant.input_indices[i]);
+      CHECK(static_cast<size_t>(arr->ndim) == input_shapes_[i].size() &&
+            std::equal(arr->shape + 1, arr->shape + arr->ndim, input_shapes_[i].begin() + 1))
+          << "Shape of input " << input_names_[i] << " in batch variant " << dir
+          << " differs in more than the batch size.";
+    }
+    variant.batch_size = executor.GetInput(variant.input_indices[0])->shape[0];
+    auto same_batch = [&variant](const TVMBatchVariant& v) {
+      return v.batch_size == variant.batch_size;
+    };
+    if (std::any_of(batch_variants_.begin(), batch_variants_.end(), same_batch)) {
+      LOG(WARNING) << "Ignoring batch variant " << dir << ", batch size " << variant.batch_size
+                   << " is loaded already.";
+      continue;
+    }
+    batch_variants_.push_back(std::move(variant));
+  }
+  std::sort(batch_variants_.begin(), batch_variants_.end(),
+            [](const TVMBatchVariant& a, const TVMBatchVariant& b) {
+              return a.batch_size < b.batch_size;
+            });
+  AddBatchContexts();
+}
+
+void TVMModel::ShareBatchVariants(const TVMModel& base) {
+  InitBatchVariants();
+  num_batch_contexts_ = base.num_batch_contexts_;
+  batch_staging_.resize(num_batch_contexts_);
+  // Graphs and libraries are shared, executors are this context's own.
+  for (const TVMBatchVariant& base_variant : base.batch_variants_) {
+    if (base_variant.batch_size == batch_variants_[0].batch_size) continue;
+    TVMBatchVariant variant;
+    variant.batch_size = base_variant.batch_size;
+    variant.graph_json = base_variant.graph_json;
+    variant.lib = base_variant.lib;
+    variant.input_indices = base_variant.input_indices;
+    variant.executors.push_back(CreateSharedExecutor(variant));
+    batch_variants_.push_back(std::move(variant));
+  }
+  std::sort(batch_variants_.begin(), batch_variants_.end(),
+            [](const TVMBatchVariant& a, const TVMBatchVariant& b) {
+              return a.batch_size < b.batch_size;
+            });
+  AddBatchContexts();
+}
+
+std::vector<int64_t> TVMModel::GetBatchVariantSizes() const {
+  std::vector<int64_t> sizes;
+  for (const TVMBatchVariant& variant : batch_variants_) sizes.push_back(variant.batch_size);
+  return sizes;
+}
+
+void TVMModel::WarnIfBatchVariants() {
+  if (HasMetadata() && metadata_.count("Model") && metadata_["Model"].count("BatchVariants")) {
+    LOG(WARNING) << "BatchVariants are only loaded for models loaded from a folder, ignoring them.";
+  }
+}
+
+void TVMModel::AddBatchContexts() {
+  for (TVMBatchVariant& variant : batch_variants_) {
+    while (variant.executors.size() < static_cast<size_t>(num_batch_contexts_)) {
+      variant.executors.push_back(CreateSharedExecutor(variant));
+    }
+  }
+}
+
+void TVMModel::SetBatchInput(int index, const int64_t* shape, const void* input, int dim) {
+  const std::vector<int64_t>& model_shape = input_shapes_[index];
+  CHECK(static_cast<size_t>(dim) == model_shape.size() &&
+        std::equal(shape + 1, shape + dim, model_shape.begin() + 1))
+      << "Shape of input " << input_names_[index]
+      << " must match the model in all but the batch dimension.";
+  const DLDataType dtype = inputs_[index]->dtype;
+  const size_t num_bytes =
+      std::accumulate(shape, shape + dim, int64_t{1}, std::multiplies<int64_t>()) *
+      ((dtype.bits * dtype.lanes + 7) / 8);
+  const char* data = static_cast<const char*>(input);
+  batch_inputs_[index].assign(data, data + num_bytes);
+  batch_input_rows_[index] = shape[0];
+}
+
+void TVMModel::EnterBatchVariants(const char* name, const int64_t* shape, const void* input,
+                                  int dim) {
+  InitBatchVariants();
+  AddBatchContexts();
+  SetBatchInput(std::find(input_names_.begin(), input_names_.end(), name) - input_names_.begin(),
+                shape, input, dim);
+}
+
+void TVMModel::LeaveBatchVariants() {
+  // Only models which switched on their own go back, variants from the metadata stay in use.
+  if (batch_variants_.size() != 1) return;
+  const TVMBatchVariant& own = batch_variants_[0];
+  for (int64_t rows : batch_input_rows_) {
+    if (rows != own.batch_size) return;
+  }
+  for (int i = 0; i < num_inputs_; i++) {
+    tvm::runtime::NDArray arr = tvm_graph_executor_->GetInput(own.input_indices[i]);
+    arr.CopyFromBytes(batch_inputs_[i].data(), batch_inputs_[i].size());
+  }
+  batch_variants_.clear();
+  batch_input_rows_.clear();
+  batch_inputs_.clear();
+  batch_outputs_.clear();
+  batch_output_shapes_.clear();
+  batch_staging_.clear();
+}
+
+void TVMModel::RunBatchVariants() {
+  const int64_t rows = batch_input_rows_[0];
+  for (int i = 0; i < num_inputs_; i++) {
+    CHECK_EQ(batch_input_rows_[i], rows) << "All inputs must have the same batch size.";
+  }
+  batch_output_shapes_.resize(num_outputs_);
+  for (int i = 0; i < num_outputs_; i++) {
+    const DLTensor* out = outputs_[i].operator->();
+    batch_output_shapes_[i].assign(out->shape, out->shape + out->ndim);
+    batch_output_shapes_[i][0] = rows;
+    batch_outputs_[i].resize(rows * (tvm::runtime::GetDataSize(*out) / out->shape[0]));
+  }
+
+  // Split the batch: the smallest variant which takes the remaining rows, or the largest one.
+  struct Chunk {
+    const TVMBatchVariant* variant;
+    int64_t first_row;
+    int64_t num_rows;
+  };
+  std::vector<Chunk> chunks;
+  for (int64_t done = 0; done < rows;) {
+    auto it = std::find_if(batch_variants_.begin(), batch_variants_.end(),
+                           [&](const TVMBatchVariant& v) { return v.batch_size >= rows - done; });
+    const TVMBatchVariant& variant = it == batch_variants_.end() ? batch_variants_.back() : *it;
+    const int64_t num_rows = std::min(rows - done, variant.batch_size);
+    chunks.push_back({&variant, done, num_rows});
+    done += num_rows;
+  }
+  const size_t num_contexts = std::min(chunks.size(), static_cast<size_t>(num_batch_contexts_));
+  ThreadPool& pool = ThreadPool::Compute();
+  if (num_contexts <= 1 || pool.GetNumThreads() == 0) {
+    for (const Chunk& chunk : chunks) {
+      RunBatchChunk(*chunk.variant, 0, chunk.first_row, chunk.num_rows);
+    }
+    return;
+  }
+  // TVM gives each thread running a graph a thread pool of its own, with TVM_NUM_THREADS
+  // threads. Contexts run on compute workers whose pools get an equal share of them, the
+  // caller's pool is left as it is. Bound pools all start at the same cores, so with binding
+  // the pools keep their size.
+  const int num_threads =
+      TVMBindsThreads() ? 0 : std::max(1, GetTVMNumThreads() / static_cast<int>(num_contexts));
+  // Context c runs chunks c, c + num_contexts, ... on its own executors.
+  std::vector<std::future<void>> futures;
+  for (size_t c = 0; c < num_contexts; c++) {
+    futures.push_back(pool.Submit([&, c]() {
+      if (num_threads > 0) ConfigureTVMThreads(num_threads);
+      for (size_t i = c; i < chunks.size(); i += num_contexts) {
+        RunBatchChunk(*chunks[i].variant, c, chunks[i].first_row, chunks[i].num_rows);
+      }
+    }));
+  }
+  // Wait for every context even on failure, the tasks reference chunks.
+  std::exception_ptr error;
+  for (std::future<void>& future : futures) {
+    try {
+      future.get();
+    } catch (...) {
+      if (!error) error = std::current_exception();
+    }
+  }
+  if (error) std::rethrow_exception(error);
+}
+
+void TVMModel::RunBatchChunk(const TVMBatchVariant& variant, int context, int64_t first_row,
+                             int64_t num_rows) {
+  tvm::runtime::GraphExecutor& executor = *variant.executors[context];
+  std::vector<char>& staging = batch_staging_[context];
+  const int64_t rows = batch_input_rows_[0];
+  for (int i = 0; i < num_inputs_; i++) {
+    tvm::runtime::NDArray arr = executor.GetInput(variant.input_indices[i]);
+    const size_t row_bytes = batch_inputs_[i].size() / rows;
+    const char* src = batch_inputs_[i].data() + first_row * row_bytes;
+    if (num_rows == variant.batch_size) {
+      arr.CopyFromBytes(src, num_rows * row_bytes);
+    } else {
+      // Pad the last chunk with zeros.
+      staging.assign(variant.batch_size * row_bytes, 0);
+      std::copy(src, src + num_rows * row_bytes, staging.begin());
+      arr.CopyFromBytes(staging.data(), staging.size());
+    }
+  }
+  executor.Run();
+  for (int i = 0; i < num_outputs_; i++) {
+    tvm::runtime::NDArray out = executor.GetOutput(i);
+    const size_t row_bytes = batch_outputs_[i].size() / rows;
+    char* dst = batch_outputs_[i].data() + first_row * row_bytes;
+    if (num_rows == variant.batch_size) {
+      out.CopyToBytes(dst, num_rows * row_bytes);
+    } else {
+      staging.resize(variant.batch_size * row_bytes);
+      out.CopyToBytes(staging.data(), staging.size());
+      std::copy(staging.begin(), staging.begin() + num_rows * row_bytes, dst);
+    }
+  }
+}
+
+TVMModel::TVMModel(const TVMModel& base, const DLDevice& dev)
+    : DLRModel(dev, DLRBackend::kTVM),
+      graph_json_(base.graph_json_),
+      lib_memory_(base.lib_memory_),
+      tvm_lib_(base.tvm_lib_),
+      lib_path_(base.lib_path_),
+      mapped_params_(base.mapped_params_) {
+  metadata_ = base.metadata_;
+  tvm_graph_executor_ = tvm::runtime::make_object<tvm::runtime::GraphExecutor>();
+  tvm_graph_executor_->Init(*graph_json_, tvm_lib_, {dev_}, nullptr);
+
+  // GraphExecutor::ShareParams() only needs the names section of a params blob, so build a
+  // blob header listing the weights instead of keeping the whole params file around.
+  std::string names_blob;
+  dmlc::MemoryStringStream strm(&names_blob);
+  const uint64_t header = tvm::runtime::kTVMNDArrayListMagic;
+  const uint64_t reserved = 0;
+  const uint64_t num_weights = base.weight_names_.size();
+  strm.Write(header);
+  strm.Write(reserved);
+  strm.Write(base.weight_names_);
+  strm.Write(num_weights);
+  strm.Seek(0);
+  tvm_graph_executor_->ShareParams(*base.tvm_graph_executor_, &strm);
+  weight_names_ = base.weight_names_;
+  BindMappedParams();
+
+  FetchExecutorData();
+  // Models which switched to batch variants on their own only have their own graph, contexts
+  // do the same when needed.
+  if (base.batch_variants_.size() > 1) ShareBatchVariants(base);
+}
+
+TVMModel* TVMModel::CreateExecutionContext() const { return new TVMModel(*this, dev_); }
+
+void TVMModel::SaveSnapshot(const std::string& path) const {
+  // Weights bound from outside the executor are not in its input buffers.
+  std::unordered_map<int, const DLTensor*> bound;
+  if (mapped_params_) {
+    for (const TVMMappedParam& param : mapped_params_->params) {
+      bound[param.input_index] = &param.tensor;
+    }
+  }
+  std::vector<std::string> names;
+  std::vector<tvm::runtime::NDArray> arrays;
+  for (const std::string& name : weight_names_) {
+    const int index = tvm_graph_executor_->GetInputIndex(name);
+    if (index < 0) continue;
+    auto it = bound.find(index);
+    tvm::runtime::NDArray input;
+    const DLTensor* tensor;
+    if (it != bound.end()) {
+      tensor = it->second;
+    } else {
+      input = tvm_graph_executor_->GetInput(index);
+      tensor = input.operator->();
+    }
+    std::vector<int64_t> shape(tensor->shape, tensor->shape + tensor->ndim);
+    tvm::runtime::NDArray array =
+        tvm::runtime::NDArray::Empty(shape, tensor->dtype, DLDevice{kDLCPU, 0});
+    array.CopyFrom(tensor);
+    names.push_back(name);
+    arrays.push_back(array);
+  }
+
+  std::vector<std::pair<DLRModelElemType, std::string>> sections = {
+      {DLRModelElemType::TVM_GRAPH, *graph_json_},
+      {DLRModelElemType::TVM_PARAMS, WriteParamsSnapshot(names, arrays)},
+      {DLRModelElemType::TVM_LIB,
+       LoadFileToString(lib_path_, std::ios::in | std::ios::binary)}};
+  if (HasMetadata()) sections.push_back({DLRModelElemType::NEO_METADATA, metadata_.dump()});
+  ModelArchive::Write(sections, path);
+}
+
+void TVMModel::FetchExecutorData() {
   tvm_module_ = std::make_shared<tvm::runtime::Module>(tvm::runtime::Module(tvm_graph_executor_));
+  zero_copy_inputs_.assign(tvm_graph_executor_->NumInputs(), nullptr);
 
-  // Get list of weights.
-  weight_names_ = tvm_graph_executor_->GetWeightNames();
   num_weights_ = weight_names_.size();
   std::unordered_set<std::string> weight_names_set(weight_names_.begin(), weight_names_.end());
   // TVM inputs contains both inputs and weights.
@@ -189,6 +842,22 @@ const char* TVMModel::GetWeightName(int index) const {
   return weight_names_[index].c_str();
 }
 
+const void* TVMModel::GetWeightData(int index) const {
+  CHECK_LT(index, num_weights_) << "Weight index is out of range.";
+  const int input_index = tvm_graph_executor_->GetInputIndex(weight_names_[index]);
+  if (input_index < 0) return nullptr;
+  if (mapped_params_) {
+    for (const TVMMappedParam& param : mapped_params_->params) {
+      if (param.input_index == input_index) return param.tensor.data;
+    }
+  }
+  return tvm_graph_executor_->GetInput(input_index)->data;
+}
+
+const MemoryMappedFile* TVMModel::GetParamsMapping() const {
+  return mapped_params_ ? mapped_params_->file.get() : nullptr;
+}
+
 void TVMModel::SetInput(const char* name, const int64_t* shape, const void* input, int dim) {
 #ifdef ENABLE_DATATRANSFORM
   // Handle string input.
@@ -202,6 +871,13 @@ void TVMModel::SetInput(const char* name, const int64_t* shape, const void* inpu
   }
 #endif
 
+  if (!batch_variants_.empty()) {
+    auto it = std::find(input_names_.begin(), input_names_.end(), name);
+    CHECK(it != input_names_.end()) << "Input " << name << " not found.";
+    SetBatchInput(it - input_names_.begin(), shape, input, dim);
+    LeaveBatchVariants();
+    return;
+  }
   std::string str(name);
   int index = tvm_graph_executor_->GetInputIndex(str);
   tvm::runtime::NDArray arr = tvm_graph_executor_->GetInput(index);
@@ -211,7 +887,19 @@ void TVMModel::SetInput(const char* name, const int64_t* shape, const void* inpu
   int64_t read_size = std::accumulate(shape, shape + dim, 1, std::multiplies<int64_t>());
   int64_t expected_size = std::accumulate(
       input_tensor.shape, input_tensor.shape + input_tensor.ndim, 1, std::multiplies<int64_t>());
+  if (read_size != expected_size && dim == input_tensor.ndim && dim > 0 && shape[0] > 0 &&
+      std::equal(shape + 1, shape + dim, input_tensor.shape + 1) && HasBatchDim()) {
+    // Another batch size than the graph's, tile the batch over runs of the graph.
+    EnterBatchVariants(name, shape, input, dim);
+    return;
+  }
   CHECK_SHAPE("Mismatch found in input data size", read_size, expected_size);
+  // Buffers from AllocDLRInputBuffer are read in place instead of being copied.
+  if (DLRBufferPool::Global().Contains(input) && BindGraphInputZeroCopy(index, &input_tensor)) {
+    UpdateInputShapes();
+    return;
+  }
+  ResetGraphInputZeroCopy(index);
   tvm::runtime::PackedFunc set_input = tvm_module_->GetFunction("set_input");
   set_input(str, &input_tensor);
   UpdateInputShapes();
@@ -231,6 +919,16 @@ void TVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
   }
 #endif
 
+  if (!batch_variants_.empty()) {
+    auto it = std::find(input_names_.begin(), input_names_.end(), name);
+    if (it == input_names_.end()) return;
+    CHECK_EQ(tensor->device.device_type, kDLCPU)
+        << "Inputs of models with batch variants must be on CPU.";
+    SetBatchInput(it - input_names_.begin(), tensor->shape,
+                  static_cast<const char*>(tensor->data) + tensor->byte_offset, tensor->ndim);
+    LeaveBatchVariants();
+    return;
+  }
   std::string str(name);
   int index = tvm_graph_executor_->GetInputIndex(str);
   if (index > -1) {
@@ -240,19 +938,34 @@ void TVMModel::SetInputTensor(const char* name, DLTensor* tensor) {
         std::accumulate(tensor->shape, tensor->shape + tensor->ndim, 1, std::multiplies<int64_t>());
     int64_t expected_size = std::accumulate(
         input_tensor.shape, input_tensor.shape + input_tensor.ndim, 1, std::multiplies<int64_t>());
+    if (read_size != expected_size && tensor->ndim == input_tensor.ndim && tensor->ndim > 0 &&
+        tensor->shape[0] > 0 &&
+        std::equal(tensor->shape + 1, tensor->shape + tensor->ndim, input_tensor.shape + 1) &&
+        HasBatchDim()) {
+      // Another batch size than the graph's, tiled like in SetInput.
+      CHECK_EQ(tensor->device.device_type, kDLCPU)
+          << "Inputs of another batch size than the graph's must be on CPU.";
+      EnterBatchVariants(name, tensor->shape,
+                         static_cast<const char*>(tensor->data) + tensor->byte_offset,
+                         tensor->ndim);
+      return;
+    }
     CHECK_SHAPE("Mismatch found in input data size", read_size, expected_size);
     tvm_graph_executor_->SetInput(index, tensor);
   }
 }
 
 void TVMModel::SetInputTensorZeroCopy(const char* name, DLTensor* tensor) {
+  CHECK(batch_variants_.empty())
+      << "SetDLRInputTensorZeroCopy is not supported for models with batch variants.";
   std::string str(name);
   int index = tvm_graph_executor_->GetInputIndex(str);
   if (index == -1) return;
   tvm::runtime::NDArray arr = tvm_graph_executor_->GetInput(index);
   const DLTensor* old_t = arr.operator->();
-  CHECK_EQ(reinterpret_cast<size_t>(tensor->data) % 128, 0)
-      << "Data must be alligned to 128 bits for SetDLRInputTensorZeroCopy.";
+  CHECK_EQ(reinterpret_cast<size_t>(tensor->data) % tvm::runtime::kAllocAlignment, 0)
+      << "Data must be aligned to " << tvm::runtime::kAllocAlignment
+      << " bytes for SetDLRInputTensorZeroCopy.";
   CHECK_EQ(old_t->ndim, static_cast<size_t>(tensor->ndim))
       << "Model expected " << old_t->ndim << " dimensions, but input has " << tensor->ndim;
   CHECK_EQ(old_t->device.device_type, tensor->device.device_type)
@@ -264,6 +977,46 @@ void TVMModel::SetInputTensorZeroCopy(const char* name, DLTensor* tensor) {
     CHECK_EQ(old_t->shape[i], tensor->shape[i]);
   }
   tvm_graph_executor_->SetInputZeroCopy(index, tensor);
+  zero_copy_inputs_[index] = tensor->data;
+}
+
+bool TVMModel::BindInputZeroCopy(int index, const DLTensor* tensor) {
+  CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+#ifdef ENABLE_DATATRANSFORM
+  if (HasMetadata() && data_transform_.HasInputTransform(metadata_)) return false;
+#endif
+  if (!batch_variants_.empty()) return false;
+  return BindGraphInputZeroCopy(tvm_graph_executor_->GetInputIndex(input_names_[index]), tensor);
+}
+
+void TVMModel::ResetInputZeroCopy(int index) {
+  CHECK_LT(index, num_inputs_) << "Input index is out of range.";
+  ResetGraphInputZeroCopy(tvm_graph_executor_->GetInputIndex(input_names_[index]));
+}
+
+bool TVMModel::BindGraphInputZeroCopy(int graph_index, const DLTensor* tensor) {
+  tvm::runtime::NDArray arr = tvm_graph_executor_->GetInput(graph_index);
+  const DLTensor* input = arr.operator->();
+  if (reinterpret_cast<size_t>(tensor->data) % tvm::runtime::kAllocAlignment != 0 ||
+      tensor->byte_offset != 0 || tensor->strides != nullptr ||
+      tensor->device.device_type != input->device.device_type ||
+      tensor->device.device_id != input->device.device_id ||
+      tensor->dtype.code != input->dtype.code || tensor->dtype.bits != input->dtype.bits ||
+      tensor->dtype.lanes != input->dtype.lanes || tensor->ndim != input->ndim ||
+      !std::equal(tensor->shape, tensor->shape + tensor->ndim, input->shape)) {
+    return false;
+  }
+  tvm_graph_executor_->SetInputZeroCopy(graph_index, const_cast<DLTensor*>(tensor));
+  zero_copy_inputs_[graph_index] = tensor->data;
+  return true;
+}
+
+void TVMModel::ResetGraphInputZeroCopy(int graph_index) {
+  if (zero_copy_inputs_[graph_index] == nullptr) return;
+  // GetInput still returns the executor's own buffer after SetInputZeroCopy.
+  tvm::runtime::NDArray arr = tvm_graph_executor_->GetInput(graph_index);
+  tvm_graph_executor_->SetInputZeroCopy(graph_index, const_cast<DLTensor*>(arr.operator->()));
+  zero_copy_inputs_[graph_index] = nullptr;
 }
 
 void TVMModel::GetInput(const char* name, void* input) {
@@ -274,6 +1027,13 @@ void TVMModel::GetInput(const char* name, void* input) {
   }
 #endif
 
+  if (!batch_variants_.empty()) {
+    auto it = std::find(input_names_.begin(), input_names_.end(), name);
+    CHECK(it != input_names_.end()) << "Input " << name << " not found.";
+    const std::vector<char>& data = batch_inputs_[it - input_names_.begin()];
+    std::copy(data.begin(), data.end(), static_cast<char*>(input));
+    return;
+  }
   std::string str(name);
   int index = tvm_graph_executor_->GetInputIndex(str);
   tvm::runtime::NDArray arr = tvm_graph_executor_->GetInput(index);
@@ -295,6 +1055,10 @@ void TVMModel::GetOutputShape(int index, int64_t* shape) const {
     return;
   }
 #endif
+  if (HasBatchOutputs()) {
+    std::copy(batch_output_shapes_[index].begin(), batch_output_shapes_[index].end(), shape);
+    return;
+  }
   std::memcpy(shape, outputs_[index]->shape, sizeof(int64_t) * outputs_[index]->ndim);
 }
 
@@ -305,19 +1069,85 @@ void TVMModel::GetOutput(int index, void* out) {
     return;
   }
 #endif
+  if (HasBatchOutputs()) {
+    std::copy(batch_outputs_[index].begin(), batch_outputs_[index].end(), static_cast<char*>(out));
+    return;
+  }
   DLTensor output_tensor = *outputs_[index].operator->();
   output_tensor.device = DLDevice{kDLCPU, 0};
   output_tensor.data = out;
+  if (!zero_copy_outputs_.empty() && zero_copy_outputs_[index].data != nullptr) {
+    tvm::runtime::NDArray::CopyFromTo(&zero_copy_outputs_[index], &output_tensor);
+    return;
+  }
   tvm::runtime::PackedFunc get_output = tvm_module_->GetFunction("get_output");
   get_output(index, &output_tensor);
 }
 
+void TVMModel::SetOutputTensorZeroCopy(int index, DLTensor* tensor) {
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+#ifdef ENABLE_DATATRANSFORM
+  CHECK(!(HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)))
+      << "Output transforms are not supported with SetDLROutputTensorZeroCopy.";
+#endif
+  CHECK(batch_variants_.empty())
+      << "SetDLROutputTensorZeroCopy is not supported for models with batch variants.";
+  zero_copy_outputs_.resize(num_outputs_, DLTensor{});
+  const DLTensor* old_t = outputs_[index].operator->();
+  if (tensor == nullptr) {
+    // outputs_ still refers to the executor's own buffer.
+    tvm_graph_executor_->SetOutputZeroCopy(index, const_cast<DLTensor*>(old_t));
+    zero_copy_outputs_[index] = DLTensor{};
+    return;
+  }
+  CHECK_EQ(reinterpret_cast<size_t>(tensor->data) % tvm::runtime::kAllocAlignment, 0)
+      << "Data must be aligned to " << tvm::runtime::kAllocAlignment
+      << " bytes for SetDLROutputTensorZeroCopy.";
+  CHECK_EQ(old_t->ndim, tensor->ndim)
+      << "Model expected " << old_t->ndim << " dimensions, but output has " << tensor->ndim;
+  CHECK_EQ(old_t->device.device_type, tensor->device.device_type)
+      << "The output data must be on device \""
+      << GetStringFromDeviceType(old_t->device.device_type) << "\", but user gave output on \""
+      << GetStringFromDeviceType(tensor->device.device_type) << "\"";
+  CHECK_EQ(old_t->device.device_id, tensor->device.device_id);
+  CHECK(old_t->dtype.code == tensor->dtype.code && old_t->dtype.bits == tensor->dtype.bits &&
+        old_t->dtype.lanes == tensor->dtype.lanes)
+      << "Output type mismatch, expected " << output_types_[index];
+  for (auto i = 0; i < tensor->ndim; ++i) {
+    CHECK_EQ(old_t->shape[i], tensor->shape[i]);
+  }
+  tvm_graph_executor_->SetOutputZeroCopy(index, tensor);
+  // Keep a copy, the caller's DLTensor may not outlive this call. The shape is the same.
+  zero_copy_outputs_[index] = *tensor;
+  zero_copy_outputs_[index].shape = old_t->shape;
+  zero_copy_outputs_[index].strides = nullptr;
+}
+
+tvm::runtime::NDArray TVMModel::GetOutputNDArray(int index) const {
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+#ifdef ENABLE_DATATRANSFORM
+  if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
+    return tvm::runtime::NDArray();
+  }
+#endif
+  if ((!zero_copy_outputs_.empty() && zero_copy_outputs_[index].data != nullptr) ||
+      !batch_variants_.empty()) {
+    return tvm::runtime::NDArray();
+  }
+  return outputs_[index];
+}
+
 const void* TVMModel::GetOutputPtr(int index) const {
 #ifdef ENABLE_DATATRANSFORM
   if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
     return data_transform_.GetOutputPtr(index);
   }
 #endif
+  if (HasBatchOutputs()) return batch_outputs_[index].data();
+  if (!zero_copy_outputs_.empty() && zero_copy_outputs_[index].data != nullptr &&
+      zero_copy_outputs_[index].device.device_type == kDLCPU) {
+    return zero_copy_outputs_[index].data;
+  }
 
   tvm::runtime::NDArray output = tvm_graph_executor_->GetOutput(index);
   const DLTensor* tensor = output.operator->();
@@ -332,6 +1162,16 @@ void TVMModel::GetOutputManagedTensorPtr(int index, const DLManagedTensor** out)
   CHECK(!(HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)))
       << "Output transforms are not supported with GetOutputManagedTensor.";
 #endif
+  // Outputs of batch variants and zero-copy outputs are not held by the executor, they are
+  // returned in an array of their own.
+  DLTensor source;
+  if (GetDetachedOutput(index, &source)) {
+    std::vector<int64_t> shape(source.shape, source.shape + source.ndim);
+    tvm::runtime::NDArray output = tvm::runtime::NDArray::Empty(shape, source.dtype, source.device);
+    output.CopyFrom(&source);
+    *out = output.ToDLPack();
+    return;
+  }
   tvm::runtime::NDArray output = tvm_graph_executor_->GetOutput(index);
   *out = output.ToDLPack();
 }
@@ -343,10 +1183,33 @@ void TVMModel::GetOutputTensor(int index, DLTensor* out) {
     return;
   }
 #endif
+  DLTensor source;
+  if (GetDetachedOutput(index, &source)) {
+    tvm::runtime::NDArray::CopyFromTo(&source, out);
+    return;
+  }
   tvm::runtime::PackedFunc get_output = tvm_module_->GetFunction("get_output");
   get_output(index, out);
 }
 
+bool TVMModel::GetDetachedOutput(int index, DLTensor* tensor) {
+  CHECK_LT(index, num_outputs_) << "Output index is out of range.";
+  if (HasBatchOutputs()) {
+    *tensor = *outputs_[index].operator->();
+    tensor->data = batch_outputs_[index].data();
+    tensor->device = DLDevice{kDLCPU, 0};
+    tensor->shape = batch_output_shapes_[index].data();
+    tensor->strides = nullptr;
+    tensor->byte_offset = 0;
+    return true;
+  }
+  if (!zero_copy_outputs_.empty() && zero_copy_outputs_[index].data != nullptr) {
+    *tensor = zero_copy_outputs_[index];
+    return true;
+  }
+  return false;
+}
+
 void TVMModel::GetOutputSizeDim(int index, int64_t* size, int* dim) {
 #ifdef ENABLE_DATATRANSFORM
   if (HasMetadata() && data_transform_.HasOutputTransform(metadata_, index)) {
@@ -354,6 +1217,12 @@ void TVMModel::GetOutputSizeDim(int index, int64_t* size, int* dim) {
     return;
   }
 #endif
+  if (HasBatchOutputs()) {
+    const std::vector<int64_t>& shape = batch_output_shapes_[index];
+    *size = std::accumulate(shape.begin(), shape.end(), int64_t{1}, std::multiplies<int64_t>());
+    *dim = shape.size();
+    return;
+  }
   *size = 1;
   const DLTensor* tensor = outputs_[index].operator->();
   for (int i = 0; i < tensor->ndim; ++i) {
@@ -378,6 +1247,10 @@ const char* TVMModel::GetOutputType(int index) const {
 }
 
 void TVMModel::Run() {
+  if (!batch_variants_.empty()) {
+    RunBatchVariants();
+    return;
+  }
   tvm::runtime::PackedFunc run = tvm_module_->GetFunction("run");
   run();
 #ifdef ENABLE_DATATRANSFORM
@@ -390,6 +1263,59 @@ void TVMModel::Run() {
 #endif
 }
 
+void TVMModel::PrepareBindings() {
+#ifdef ENABLE_DATATRANSFORM
+  CHECK(!(HasMetadata() && data_transform_.HasInputTransform(metadata_)))
+      << "Input transforms are not supported with prepared bindings.";
+  for (int i = 0; i < num_outputs_; i++) {
+    CHECK(!(HasMetadata() && data_transform_.HasOutputTransform(metadata_, i)))
+        << "Output transforms are not supported with prepared bindings.";
+  }
+#endif
+  CHECK(batch_variants_.empty()) << "Prepared bindings are not supported with batch variants.";
+  auto host_view = [](const tvm::runtime::NDArray& arr) {
+    DLTensor view = *arr.operator->();
+    view.device = DLDevice{kDLCPU, 0};
+    view.data = nullptr;
+    view.byte_offset = 0;
+    view.strides = nullptr;
+    return view;
+  };
+  bound_inputs_.resize(num_inputs_);
+  bound_input_views_.resize(num_inputs_);
+  for (int i = 0; i < num_inputs_; i++) {
+    // RunBound copies into the executor's own buffers.
+    ResetInputZeroCopy(i);
+    bound_inputs_[i] =
+        tvm_graph_executor_->GetInput(tvm_graph_executor_->GetInputIndex(input_names_[i]));
+    bound_input_views_[i] = host_view(bound_inputs_[i]);
+  }
+  bound_output_views_.resize(num_outputs_);
+  for (int i = 0; i < num_outputs_; i++) {
+    bound_output_views_[i] = host_view(outputs_[i]);
+  }
+}
+
+void TVMModel::RunBound(const void* const* inputs, void* const* outputs) {
+  CHECK_EQ(bound_inputs_.size(), static_cast<size_t>(num_inputs_))
+      << "Call PrepareBindings before RunBound.";
+  for (int i = 0; i < num_inputs_; i++) {
+    DLTensor view = bound_input_views_[i];
+    view.data = const_cast<void*>(inputs[i]);
+    bound_inputs_[i].CopyFrom(&view);
+  }
+  tvm_graph_executor_->Run();
+  for (int i = 0; i < num_outputs_; i++) {
+    DLTensor view = bound_output_views_[i];
+    view.data = outputs[i];
+    if (!zero_copy_outputs_.empty() && zero_copy_outputs_[i].data != nullptr) {
+      tvm::runtime::NDArray::CopyFromTo(&zero_copy_outputs_[i], &view);
+    } else {
+      outputs_[i].CopyTo(&view);
+    }
+  }
+}
+
 static inline int SetEnv(const char* key, const char* value) {
 #ifdef _WIN32
   return static_cast<int>(_putenv_s(key, value));
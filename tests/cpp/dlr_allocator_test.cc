@@ -215,3 +215,83 @@ TEST_F(CustomAllocatorTrackingTest, CustomAllocatorsTvm) {
   size_t free_count_after = CustomAllocatorTrackingTest::free_calls_.size();
   EXPECT_GT(free_count_after, free_count_before);
 }
+
+TEST(DLRBufferPoolTest, AllocReusesFreedBuffers) {
+  dlr::DLRBufferPool pool;
+  void* p = pool.Alloc(1000);
+  EXPECT_EQ(reinterpret_cast<size_t>(p) % dlr::DLRBufferPool::kAlignment, 0);
+  EXPECT_TRUE(pool.Contains(p));
+  EXPECT_NO_THROW(pool.Free(p));
+  EXPECT_FALSE(pool.Contains(p));
+  EXPECT_THROW(pool.Free(p), dmlc::Error);
+  // Same size is served from the pool.
+  void* q = pool.Alloc(1000);
+  EXPECT_EQ(p, q);
+  void* r = pool.Alloc(1000);
+  EXPECT_NE(q, r);
+  pool.Free(q);
+  pool.Free(r);
+  pool.Trim();
+}
+
+TEST(DLRBufferPoolTest, SizeClasses) {
+  EXPECT_EQ(dlr::DLRBufferPool::SizeClass(0), 64);
+  EXPECT_EQ(dlr::DLRBufferPool::SizeClass(64), 64);
+  EXPECT_EQ(dlr::DLRBufferPool::SizeClass(100), 128);
+  EXPECT_EQ(dlr::DLRBufferPool::SizeClass(600), 640);
+  EXPECT_EQ(dlr::DLRBufferPool::SizeClass(1000), 1024);
+  EXPECT_EQ(dlr::DLRBufferPool::SizeClass(1 << 20), 1 << 20);
+  EXPECT_EQ(dlr::DLRBufferPool::SizeClass((1 << 20) + 1), (1 << 20) + (1 << 18));
+  // Sizes of one class share buffers.
+  dlr::DLRBufferPool pool;
+  void* p = pool.Alloc(1000);
+  pool.Free(p);
+  EXPECT_EQ(pool.Alloc(900), p);
+  pool.Free(p);
+}
+
+TEST(DLRBufferPoolTest, StatsAndLimit) {
+  dlr::DLRBufferPool pool;
+  void* p = pool.Alloc(1024);
+  void* q = pool.Alloc(2048);
+  dlr::DLRBufferPoolStats stats = pool.GetStats();
+  EXPECT_EQ(stats.bytes_in_use, 3072);
+  EXPECT_EQ(stats.bytes_cached, 0);
+  EXPECT_EQ(stats.num_misses, 2);
+  pool.SetMaxCachedBytes(1024);
+  pool.Free(p);
+  // Over the limit, released instead of cached.
+  pool.Free(q);
+  stats = pool.GetStats();
+  EXPECT_EQ(stats.bytes_in_use, 0);
+  EXPECT_EQ(stats.bytes_cached, 1024);
+  EXPECT_EQ(pool.Alloc(1024), p);
+  EXPECT_EQ(pool.GetStats().num_hits, 1);
+  pool.Free(p);
+  pool.Trim();
+  EXPECT_EQ(pool.GetStats().bytes_cached, 0);
+}
+
+TEST_F(CustomAllocatorTrackingTest, BufferPoolFreesWithAllocatingFunctions) {
+  dlr::DLRBufferPool pool;
+  // Allocated by the system allocator, freed after custom functions were set.
+  void* p = pool.Alloc(1024);
+  dlr::DLRAllocatorFunctions::SetFreeFunction(tracking_free);
+  dlr::DLRAllocatorFunctions::SetMemalignFunction(tracking_memalign);
+  void* q = pool.Alloc(4096);
+  EXPECT_EQ(CustomAllocatorTrackingTest::memalign_calls_.size(), 1);
+  pool.Free(p);
+  pool.Trim();
+  EXPECT_EQ(CustomAllocatorTrackingTest::free_calls_.size(), 0);
+  // Allocated by the custom functions, freed after they were cleared.
+  dlr::DLRAllocatorFunctions::Clear();
+  pool.Free(q);
+  pool.Trim();
+  ASSERT_EQ(CustomAllocatorTrackingTest::free_calls_.size(), 1);
+  EXPECT_EQ(CustomAllocatorTrackingTest::free_calls_[0], q);
+  // A custom memalign without a custom free is not used.
+  dlr::DLRAllocatorFunctions::SetMemalignFunction(tracking_memalign);
+  pool.Free(pool.Alloc(8192));
+  pool.Trim();
+  EXPECT_EQ(CustomAllocatorTrackingTest::memalign_calls_.size(), 1);
+}
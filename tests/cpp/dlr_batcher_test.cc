@@ -0,0 +1,206 @@
+#include "dlr_batcher.h"
+
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <memory>
+#include <thread>
+
+#include "dlr.h"
+#include "dlr_relayvm.h"
+#include "dlr_treelite.h"
+#include "dlr_tvm.h"
+#include "test_utils.hpp"
+
+class BatcherTest : public ::testing::Test {
+ protected:
+  const int num_requests = 16;
+  const int64_t num_features = 69;
+  std::vector<std::vector<float>> data;
+  std::vector<float> expected;
+  DLDevice dev = {DLDeviceType::kDLCPU, 0};
+  std::vector<std::string> files;
+
+  BatcherTest() {
+    std::vector<std::string> paths = {"./xgboost_test"};
+    files = dlr::FindFiles(paths);
+    dlr::TreeliteModel model(files, dev);
+    for (int i = 0; i < num_requests; i++) {
+      std::vector<float> row(num_features);
+      for (auto& v : row) {
+        v = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+      }
+      // Score every request on its own for reference.
+      const int64_t shape[2] = {1, num_features};
+      model.SetInput("data", shape, row.data(), 2);
+      model.Run();
+      float out;
+      model.GetOutput(0, &out);
+      expected.push_back(out);
+      data.push_back(row);
+    }
+  }
+};
+
+TEST_F(BatcherTest, TestConcurrentRequests) {
+  dlr::TreeliteModel model(files, dev);
+  dlr::DLRBatcher batcher(&model, 8, 1000);
+  std::vector<float> results(num_requests, -1.0f);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_requests; i++) {
+    threads.emplace_back([&, i]() {
+      const void* inputs[1] = {data[i].data()};
+      void* outputs[1] = {&results[i]};
+      EXPECT_NO_THROW(batcher.Submit(1, inputs, outputs));
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (int i = 0; i < num_requests; i++) {
+    EXPECT_FLOAT_EQ(results[i], expected[i]);
+  }
+}
+
+TEST_F(BatcherTest, TestCoalescing) {
+  // The delay never expires, requests run once max_batch rows are queued.
+  dlr::TreeliteModel model(files, dev);
+  dlr::DLRBatcher batcher(&model, 8, 60 * 1000 * 1000);
+  std::vector<float> results(num_requests, -1.0f);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_requests; i++) {
+    threads.emplace_back([&, i]() {
+      const void* inputs[1] = {data[i].data()};
+      void* outputs[1] = {&results[i]};
+      EXPECT_NO_THROW(batcher.Submit(1, inputs, outputs));
+    });
+  }
+  for (auto& t : threads) t.join();
+  EXPECT_EQ(batcher.GetNumRuns(), num_requests / 8);
+  for (int i = 0; i < num_requests; i++) {
+    EXPECT_FLOAT_EQ(results[i], expected[i]);
+  }
+}
+
+TEST_F(BatcherTest, TestDeleteWhileWaiting) {
+  dlr::TreeliteModel model(files, dev);
+  auto batcher = std::make_unique<dlr::DLRBatcher>(&model, 8, 60 * 1000 * 1000);
+  dlr::DLRBatcher* submit_to = batcher.get();
+  float result = -1.0f;
+  std::thread thread([&, submit_to]() {
+    const void* inputs[1] = {data[0].data()};
+    void* outputs[1] = {&result};
+    EXPECT_THROW(submit_to->Submit(1, inputs, outputs), dmlc::Error);
+  });
+  // Give the request time to be queued, the batcher then waits for it to fail and return.
+  std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  batcher.reset();
+  thread.join();
+  EXPECT_EQ(result, -1.0f);
+}
+
+TEST_F(BatcherTest, TestCAPI) {
+  DLRModelHandle model = nullptr;
+  EXPECT_EQ(CreateDLRModel(&model, "./xgboost_test", 1, 0), 0);
+  DLRBatcherHandle batcher = nullptr;
+  EXPECT_EQ(CreateDLRBatcher(&model, 4, 100, &batcher), 0);
+  float result = -1.0f;
+  const void* inputs[1] = {data[0].data()};
+  void* outputs[1] = {&result};
+  EXPECT_EQ(SubmitDLRRequest(&batcher, 1, inputs, outputs), 0);
+  EXPECT_FLOAT_EQ(result, expected[0]);
+  // Requests larger than max_batch are rejected.
+  EXPECT_EQ(SubmitDLRRequest(&batcher, 5, inputs, outputs), -1);
+  EXPECT_EQ(DeleteDLRBatcher(&batcher), 0);
+  DeleteDLRModel(&model);
+}
+
+TEST(Batcher, TestTVMPadding) {
+  // Graph compiled for batches of 4 whose output is its input.
+  const int64_t batch = 4, cols = 3;
+  const std::string graph = MakeIdentityGraphJson("x", batch, cols);
+  const std::string params = MakeEmptyParams();
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, nullptr, graph.c_str(), 0},
+      {DLRModelElemType::TVM_PARAMS, nullptr, params.data(), params.size()},
+      {DLRModelElemType::TVM_LIB, "./resnet_v1_5_50/compiled.so", nullptr, 0}};
+  dlr::TVMModel model(model_elems, DLDevice{kDLCPU, 0});
+  // max_batch is capped to the compiled batch size.
+  dlr::DLRBatcher batcher(&model, 8, 1000);
+
+  // A lone request runs padded to the compiled batch.
+  std::vector<float> row = {1.0f, 2.0f, 3.0f};
+  std::vector<float> result(cols, -1.0f);
+  const void* inputs[1] = {row.data()};
+  void* outputs[1] = {result.data()};
+  EXPECT_NO_THROW(batcher.Submit(1, inputs, outputs));
+  EXPECT_EQ(result, row);
+  // Requests of 5 rows do not fit the compiled batch.
+  EXPECT_THROW(batcher.Submit(5, inputs, outputs), dmlc::Error);
+
+  const int num_requests = 10;
+  std::vector<std::vector<float>> data(num_requests);
+  std::vector<std::vector<float>> results(num_requests);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_requests; i++) {
+    const int64_t num_rows = i % 2 + 1;
+    for (int64_t j = 0; j < num_rows * cols; j++) data[i].push_back(i * 100 + j);
+    results[i].assign(num_rows * cols, -1.0f);
+    threads.emplace_back([&, i, num_rows]() {
+      const void* inputs[1] = {data[i].data()};
+      void* outputs[1] = {results[i].data()};
+      EXPECT_NO_THROW(batcher.Submit(num_rows, inputs, outputs));
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (int i = 0; i < num_requests; i++) {
+    EXPECT_EQ(results[i], data[i]);
+  }
+}
+
+TEST(Batcher, TestRelayVM) {
+  dlr::RelayVMModel model(dlr::FindFiles({"./ssd_mobilenet_v1"}), DLDevice{kDLCPU, 0});
+  const int num_requests = 3;
+  const size_t img_size = 512 * 512 * 3;
+  const int64_t shape[4] = {1, 512, 512, 3};
+  const std::vector<size_t> output_sizes = {100, 1, 400, 100};
+  std::vector<std::vector<uint8_t>> images(num_requests);
+  std::vector<std::vector<std::vector<float>>> expected(num_requests);
+  for (int i = 0; i < num_requests; i++) {
+    images[i].resize(img_size);
+    for (size_t j = 0; j < img_size; j++) images[i][j] = static_cast<uint8_t>(j * (i + 1));
+    // Run every request on its own for reference.
+    model.SetInput("image_tensor", shape, images[i].data(), 4);
+    model.Run();
+    for (size_t k = 0; k < output_sizes.size(); k++) {
+      expected[i].emplace_back(output_sizes[k]);
+      model.GetOutput(k, expected[i][k].data());
+    }
+  }
+
+  dlr::DLRBatcher batcher(&model, 4, 1000);
+  std::vector<std::vector<std::vector<float>>> results(num_requests);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_requests; i++) {
+    for (size_t size : output_sizes) results[i].emplace_back(size, -1.0f);
+    threads.emplace_back([&, i]() {
+      const void* inputs[1] = {images[i].data()};
+      void* outputs[4] = {results[i][0].data(), results[i][1].data(), results[i][2].data(),
+                          results[i][3].data()};
+      EXPECT_NO_THROW(batcher.Submit(1, inputs, outputs));
+    });
+  }
+  for (auto& t : threads) t.join();
+  // The model is compiled for batch 1, requests are never coalesced. Coalescing into one run of
+  // a dynamic batch is covered by TestCoalescing.
+  EXPECT_EQ(batcher.GetNumRuns(), num_requests);
+  for (int i = 0; i < num_requests; i++) {
+    EXPECT_EQ(results[i], expected[i]);
+  }
+}
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
@@ -1,4 +1,7 @@
 #include <gtest/gtest.h>
+
+#include <future>
+
 #include "dlr.h"
 #include "test_utils.hpp"
 
@@ -200,6 +203,53 @@ TEST(PipelineTest, TestRunDLRModel_GetDLROutput) {
   DeleteDLRModel(&model);
 }
 
+TEST(PipelineTest, TestRunDLRModelRepeated) {
+  // Stages hand tensors over without copies, results must follow the latest inputs.
+  auto model = GetDLRModel();
+  size_t img_size = 4 * 4;
+  std::vector<float> img0(img_size, 0.1);
+  std::vector<float> img1(img_size, 0.3);
+  std::vector<float> other(img_size, 0.7);
+  int64_t shape[4] = {1, 1, 4, 4};
+  float output0[16];
+  EXPECT_EQ(SetDLRInput(&model, "input_0", shape, other.data(), 4), 0);
+  EXPECT_EQ(SetDLRInput(&model, "input_1", shape, other.data(), 4), 0);
+  EXPECT_EQ(RunDLRModel(&model), 0);
+  EXPECT_EQ(GetDLROutput(&model, 0, output0), 0);
+  EXPECT_NE(output0[0], 0.442f);
+  EXPECT_EQ(SetDLRInput(&model, "input_0", shape, img0.data(), 4), 0);
+  EXPECT_EQ(SetDLRInput(&model, "input_1", shape, img1.data(), 4), 0);
+  EXPECT_EQ(RunDLRModel(&model), 0);
+  EXPECT_EQ(GetDLROutput(&model, 0, output0), 0);
+  EXPECT_FLOAT_EQ(output0[0], 0.442);
+  DeleteDLRModel(&model);
+}
+
+TEST(PipelineTest, TestRunDLRPipelineAsync) {
+  auto model = GetDLRModel();
+  const int num_requests = 8;
+  size_t img_size = 4 * 4;
+  std::vector<float> img0(img_size, 0.1);
+  std::vector<float> img1(img_size, 0.3);
+  std::vector<std::vector<float>> output0(num_requests, std::vector<float>(img_size));
+  std::vector<std::vector<float>> output1(num_requests, std::vector<float>(img_size));
+  std::vector<std::promise<int>> done(num_requests);
+  auto callback = [](int status, void* user_data) {
+    static_cast<std::promise<int>*>(user_data)->set_value(status);
+  };
+  const void* inputs[2] = {img0.data(), img1.data()};
+  for (int i = 0; i < num_requests; i++) {
+    void* outputs[2] = {output0[i].data(), output1[i].data()};
+    EXPECT_EQ(RunDLRPipelineAsync(&model, inputs, outputs, callback, &done[i]), 0);
+  }
+  for (int i = 0; i < num_requests; i++) {
+    EXPECT_EQ(done[i].get_future().get(), 0);
+    EXPECT_FLOAT_EQ(output0[i][0], 0.442);
+    EXPECT_FLOAT_EQ(output1[i][0], 0.00516);
+  }
+  DeleteDLRModel(&model);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 #ifndef _WIN32
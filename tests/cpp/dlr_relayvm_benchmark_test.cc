@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <new>
+
+#include "dlr_relayvm.h"
+#include "test_utils.hpp"
+
+// Counts heap allocations made by the test thread while counting is enabled.
+static std::atomic<size_t> num_allocations{0};
+static thread_local bool count_allocations = false;
+
+void* operator new(size_t size) {
+  if (count_allocations) num_allocations++;
+  void* ptr = std::malloc(size == 0 ? 1 : size);
+  if (ptr == nullptr) throw std::bad_alloc();
+  return ptr;
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+int main(int argc, char** argv) {
+  testing::InitGoogleTest(&argc, argv);
+#ifndef _WIN32
+  testing::FLAGS_gtest_death_test_style = "threadsafe";
+#endif  // _WIN32
+  return RUN_ALL_TESTS();
+}
+
+class RelayVMBenchmark : public ::testing::Test {
+ protected:
+  const int kWarmupRuns = 3;
+  const int kRuns = 20;
+  const int64_t input_shape[4] = {1, 512, 512, 3};
+  const int input_dim = 4;
+  std::vector<int8_t> img{std::vector<int8_t>(512 * 512 * 3)};
+  float output[100];
+
+  dlr::RelayVMModel* model;
+
+  RelayVMBenchmark() {
+    DLDevice dev = {kDLCPU, 0};
+    std::vector<std::string> paths = {"./ssd_mobilenet_v1"};
+    model = new dlr::RelayVMModel(dlr::FindFiles(paths), dev);
+  }
+
+  ~RelayVMBenchmark() { delete model; }
+
+  size_t CountAllocations(const std::function<void()>& fn) {
+    num_allocations = 0;
+    count_allocations = true;
+    fn();
+    count_allocations = false;
+    return num_allocations;
+  }
+};
+
+TEST_F(RelayVMBenchmark, SteadyStateSetInputAndGetOutputDoNotAllocate) {
+  for (int i = 0; i < kWarmupRuns; i++) {
+    model->SetInput("image_tensor", input_shape, img.data(), input_dim);
+    model->Run();
+    model->GetOutput(3, output);
+  }
+  EXPECT_EQ(CountAllocations([&]() {
+              model->SetInput("image_tensor", input_shape, img.data(), input_dim);
+            }),
+            0);
+  model->Run();
+  EXPECT_EQ(CountAllocations([&]() { model->GetOutput(3, output); }), 0);
+}
+
+TEST_F(RelayVMBenchmark, SteadyStateRun) {
+  model->SetInput("image_tensor", input_shape, img.data(), input_dim);
+  for (int i = 0; i < kWarmupRuns; i++) model->Run();
+
+  // DLR adds no allocations of its own to Run(), so the count is whatever the VM interpreter
+  // needs for its frame and output containers and must not grow from one run to the next.
+  const size_t baseline = CountAllocations([&]() { model->Run(); });
+  size_t total = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < kRuns; i++) {
+    size_t count = CountAllocations([&]() { model->Run(); });
+    EXPECT_EQ(count, baseline) << "run " << i;
+    total += count;
+  }
+  auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  std::cout << "RelayVMModel::Run: " << elapsed.count() / kRuns << " us/run, "
+            << total / kRuns << " allocations/run" << std::endl;
+  RecordProperty("us_per_run", static_cast<int>(elapsed.count() / kRuns));
+  RecordProperty("allocations_per_run", static_cast<int>(total / kRuns));
+}
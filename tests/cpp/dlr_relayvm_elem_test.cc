@@ -47,15 +47,34 @@ TEST_F(RelayVMElemTest, TestCreateModel_LibTvmIsPointer) {
   std::string meta_str = dlr::LoadFileToString(meta_file);
   std::vector<DLRModelElem> model_elems = {
       {DLRModelElemType::RELAY_EXEC, nullptr, code_data.data(), code_data.size()},
-      {DLRModelElemType::TVM_LIB, nullptr, so_file.data(), so_file.size()},
+      {DLRModelElemType::TVM_LIB, nullptr, so_data.data(), so_data.size()},
+      {DLRModelElemType::NEO_METADATA, nullptr, meta_str.c_str(), 0}};
+  dlr::RelayVMModel memory_model(model_elems, dev);
+
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(memory_model.SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(memory_model.Run());
+  std::vector<float> expected(100);
+  std::vector<float> observed(100);
+  EXPECT_NO_THROW(model->GetOutput(3, expected.data()));
+  EXPECT_NO_THROW(memory_model.GetOutput(3, observed.data()));
+  EXPECT_EQ(expected, observed);
+}
+
+TEST_F(RelayVMElemTest, TestCreateModel_LibTvmIsEmpty) {
+  std::string code_data = dlr::LoadFileToString(ro_file, std::ios::binary);
+  std::string meta_str = dlr::LoadFileToString(meta_file);
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::RELAY_EXEC, nullptr, code_data.data(), code_data.size()},
+      {DLRModelElemType::TVM_LIB, nullptr, nullptr, 0},
       {DLRModelElemType::NEO_METADATA, nullptr, meta_str.c_str(), 0}};
   EXPECT_THROW(
       {
         try {
           new dlr::RelayVMModel(model_elems, dev);
         } catch (const dmlc::Error& e) {
-          EXPECT_STREQ(e.what(),
-                       "Invalid RelayVM model element TVM_LIB. TVM_LIB must be a file path.");
+          EXPECT_STREQ(e.what(), "Invalid RelayVM model element TVM_LIB");
           throw;
         }
       },
@@ -2,8 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+
 #include <nlohmann/json.hpp>
 
+#include "dlr.h"
 #include "test_utils.hpp"
 
 int main(int argc, char** argv) {
@@ -140,6 +143,63 @@ TEST_F(RelayVMTest, TestGetOutput) {
   }
 }
 
+TEST_F(RelayVMTest, TestSetInputTensorZeroCopy) {
+  for (size_t i = 0; i < img_size; i++) img[i] = static_cast<int8_t>(i % 251);
+  EXPECT_NO_THROW(model->SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  float expected[100];
+  EXPECT_NO_THROW(model->GetOutput(3, expected));
+
+  std::vector<int64_t> shape(std::begin(input_shape), std::end(input_shape));
+  tvm::runtime::NDArray arr =
+      tvm::runtime::NDArray::Empty(shape, DLDataType{kDLUInt, 8, 1}, DLDevice{kDLCPU, 0});
+  arr.CopyFromBytes(img.data(), img_size);
+  DLTensor tensor = *arr.operator->();
+  EXPECT_NO_THROW(model->SetInputTensorZeroCopy("image_tensor", &tensor));
+  EXPECT_NO_THROW(model->Run());
+  float output[100];
+  EXPECT_NO_THROW(model->GetOutput(3, output));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(output[i], expected[i]);
+  }
+
+  // Misaligned data is rejected rather than copied.
+  tensor.data = static_cast<char*>(tensor.data) + 1;
+  EXPECT_THROW(model->SetInputTensorZeroCopy("image_tensor", &tensor), dmlc::Error);
+}
+
+TEST_F(RelayVMTest, TestRelayVMPool) {
+  // The pool is opt-in, models loaded by default use TVM's.
+  EXPECT_FALSE(dlr::DLRBufferPool::IsRelayVMHookInstalled());
+  EXPECT_EQ(SetEnv("DLR_RELAYVM_ALLOCATOR", "dlr"), 0);
+  dlr::RelayVMModel pooled(dlr::FindFiles({"./ssd_mobilenet_v1"}), DLDevice{kDLCPU, 0});
+  EXPECT_EQ(SetEnv("DLR_RELAYVM_ALLOCATOR", ""), 0);
+  EXPECT_TRUE(dlr::DLRBufferPool::IsRelayVMHookInstalled());
+  // Custom allocators would free buffers of the pool.
+  EXPECT_EQ(SetDLRCustomAllocatorFree(free), -1);
+  EXPECT_EQ(dlr::DLRAllocatorFunctions::GetFreeFunction(), nullptr);
+
+  EXPECT_NO_THROW(pooled.SetInput("image_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(pooled.Run());
+  EXPECT_NO_THROW(pooled.Run());
+  size_t bytes_cached = 0;
+  size_t bytes_in_use = 0;
+  float hit_rate = 0.0f;
+  EXPECT_EQ(GetDLRRelayVMPoolStats(&bytes_cached, &bytes_in_use, &hit_rate), 0);
+  EXPECT_GT(bytes_in_use, 0);
+  // Second run reuses the buffers of the first one.
+  EXPECT_GT(hit_rate, 0.0f);
+
+  EXPECT_EQ(SetDLRRelayVMPoolLimit(1 << 20), 0);
+  EXPECT_EQ(GetDLRRelayVMPoolStats(&bytes_cached, &bytes_in_use, &hit_rate), 0);
+  EXPECT_LE(bytes_cached, 1 << 20);
+  EXPECT_EQ(TrimDLRRelayVMPool(), 0);
+  EXPECT_EQ(GetDLRRelayVMPoolStats(&bytes_cached, &bytes_in_use, &hit_rate), 0);
+  EXPECT_EQ(bytes_cached, 0);
+  EXPECT_NO_THROW(pooled.Run());
+  EXPECT_EQ(SetDLRRelayVMPoolLimit(dlr::DLRBufferPool::kRelayVMMaxCachedBytes), 0);
+}
+
 TEST(DLR, TestRelayVMAllocatorDefault) {
   DLDevice dev = {static_cast<DLDeviceType>(kDLCPU), 0};
   std::vector<std::string> paths = {"./ssd_mobilenet_v1"};
@@ -181,3 +241,124 @@ TEST(DLR, TestRelayVMAllocatorFromMetadata) {
   EXPECT_EQ(model->GetAllocatorType(), tvm::runtime::vm::AllocatorType::kNaive);
   delete model;
 }
+
+TEST(DLR, TestRelayVMShapeBuckets) {
+  DLDevice dev = {static_cast<DLDeviceType>(kDLCPU), 0};
+  std::string ro_file = "./ssd_mobilenet_v1/code.ro";
+  std::string so_file = "./ssd_mobilenet_v1/compiled.so";
+  std::string meta_file = "./ssd_mobilenet_v1/compiled.meta";
+  std::ifstream ifs(meta_file);
+  nlohmann::json metadata = nlohmann::json::parse(ifs);
+  // Treat height and width as dynamic, the compiled 512x512 is the only bucket.
+  metadata["Model"]["Inputs"][0]["shape"] = {1, nullptr, nullptr, 3};
+  metadata["Model"]["ShapeBuckets"] = {512, 256};
+  std::string meta_str = metadata.dump();
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::RELAY_EXEC, ro_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_LIB, so_file.c_str(), nullptr, 0},
+      {DLRModelElemType::NEO_METADATA, nullptr, meta_str.c_str(), meta_str.size()}};
+  dlr::RelayVMModel model(model_elems, dev);
+  EXPECT_EQ(model.GetShapeBuckets(), std::vector<int64_t>({256, 512}));
+
+  const int64_t shape[4] = {1, 300, 500, 3};
+  std::vector<uint8_t> img(300 * 500 * 3);
+  for (size_t i = 0; i < img.size(); i++) img[i] = static_cast<uint8_t>(i % 251);
+  EXPECT_NO_THROW(model.SetInput("image_tensor", shape, img.data(), 4));
+  EXPECT_NO_THROW(model.Run());
+  // GetInput returns the input without padding.
+  std::vector<uint8_t> input(img.size());
+  EXPECT_NO_THROW(model.GetInput("image_tensor", input.data()));
+  EXPECT_EQ(input, img);
+  // Same bucket, buffers are reused.
+  EXPECT_NO_THROW(model.SetInput("image_tensor", shape, img.data(), 4));
+  EXPECT_NO_THROW(model.Run());
+  int64_t size;
+  int dim;
+  EXPECT_NO_THROW(model.GetOutputSizeDim(3, &size, &dim));
+  EXPECT_EQ(size, 100);
+  std::vector<std::vector<float>> padded_outputs(model.GetNumOutputs());
+  for (int i = 0; i < model.GetNumOutputs(); i++) {
+    EXPECT_NO_THROW(model.GetOutputSizeDim(i, &size, &dim));
+    padded_outputs[i].resize(size);
+    EXPECT_NO_THROW(model.GetOutput(i, padded_outputs[i].data()));
+  }
+
+  // The same image zero-padded by the caller matches the bucket and is not padded again, its
+  // outputs must be those of the padded run.
+  const int64_t bucket_shape[4] = {1, 512, 512, 3};
+  std::vector<uint8_t> padded_img(512 * 512 * 3, 0);
+  for (int h = 0; h < 300; h++) {
+    std::copy(img.begin() + h * 500 * 3, img.begin() + (h + 1) * 500 * 3,
+              padded_img.begin() + h * 512 * 3);
+  }
+  EXPECT_NO_THROW(model.SetInput("image_tensor", bucket_shape, padded_img.data(), 4));
+  EXPECT_NO_THROW(model.Run());
+  for (int i = 0; i < model.GetNumOutputs(); i++) {
+    std::vector<float> output(padded_outputs[i].size());
+    EXPECT_NO_THROW(model.GetOutput(i, output.data()));
+    EXPECT_EQ(output, padded_outputs[i]) << "output " << i;
+  }
+}
+
+TEST(DLR, TestRelayVMSliceOutputs) {
+  // No test model has an output following a padded input length, so the slicing of a run with
+  // a sequence padded from 5 to 8 is checked on an output of shape [2, 8, 3].
+  const std::vector<std::pair<int64_t, int64_t>> padded_lengths = {{8, 5}};
+  std::vector<int64_t> shape = {2, 8, 3};
+  EXPECT_TRUE(dlr::GetSlicedOutputShape({2, -1, 3}, padded_lengths, &shape));
+  EXPECT_EQ(shape, std::vector<int64_t>({2, 5, 3}));
+
+  const int64_t padded_shape[3] = {2, 8, 3};
+  std::vector<float> padded(2 * 8 * 3);
+  for (size_t i = 0; i < padded.size(); i++) padded[i] = static_cast<float>(i);
+  std::vector<float> sliced(2 * 5 * 3, -1.0f);
+  dlr::CopyRegion(reinterpret_cast<const char*>(padded.data()), padded_shape,
+                  reinterpret_cast<char*>(sliced.data()), shape.data(), 3, sizeof(float));
+  for (int64_t b = 0; b < 2; b++) {
+    for (int64_t t = 0; t < 5; t++) {
+      for (int64_t c = 0; c < 3; c++) {
+        EXPECT_EQ(sliced[(b * 5 + t) * 3 + c], padded[(b * 8 + t) * 3 + c]);
+      }
+    }
+  }
+
+  // Static dimensions and dimensions of other lengths are left alone.
+  shape = {8, 8, 7};
+  EXPECT_TRUE(dlr::GetSlicedOutputShape({8, -1, -1}, padded_lengths, &shape));
+  EXPECT_EQ(shape, std::vector<int64_t>({8, 5, 7}));
+  shape = {8, 7};
+  EXPECT_FALSE(dlr::GetSlicedOutputShape({8, -1}, padded_lengths, &shape));
+  EXPECT_EQ(shape, std::vector<int64_t>({8, 7}));
+  // Dimensions missing from the metadata are dynamic.
+  shape = {8};
+  EXPECT_TRUE(dlr::GetSlicedOutputShape({}, padded_lengths, &shape));
+  EXPECT_EQ(shape, std::vector<int64_t>({5}));
+}
+
+TEST(DLR, TestRelayVMInputBuffers) {
+  dlr::RelayVMModel model(dlr::FindFiles({"./ssd_mobilenet_v1"}), DLDevice{kDLCPU, 0});
+  const int64_t num_shapes = dlr::RelayVMModel::kMaxInputBuffers;
+  std::vector<uint8_t> img((num_shapes + 1) * (num_shapes + 1) * 3);
+  // Inputs of another size than the model's are only copied, not run.
+  auto set_input = [&](int64_t side) {
+    const int64_t shape[4] = {1, side, side, 3};
+    model.SetInput("image_tensor", shape, img.data(), 4);
+    return model.GetInputNDArray(0);
+  };
+  std::vector<tvm::runtime::NDArray> buffers;
+  for (int64_t side = 1; side <= num_shapes; side++) {
+    buffers.push_back(set_input(side));
+    EXPECT_EQ(buffers.back().Shape()[1], side);
+  }
+  // A shape seen before gets its buffer back, as long as no more than kMaxInputBuffers shapes
+  // were used.
+  for (int64_t side = 1; side <= num_shapes; side++) {
+    EXPECT_TRUE(set_input(side).same_as(buffers[side - 1]));
+  }
+  // One more shape drops the oldest buffer, the others are kept.
+  set_input(num_shapes + 1);
+  EXPECT_FALSE(set_input(1).same_as(buffers[0]));
+  for (int64_t side = 3; side <= num_shapes; side++) {
+    EXPECT_TRUE(set_input(side).same_as(buffers[side - 1]));
+  }
+}
@@ -2,7 +2,12 @@
 
 #include <gtest/gtest.h>
 
+#include <cstdio>
+#include <future>
+#include <thread>
+
 #include "dlr_common.h"
+#include "dlr_tvm.h"
 #include "test_utils.hpp"
 
 DLRModelHandle GetDLRModel() {
@@ -388,6 +393,120 @@ TEST(DLR, TestSetInputTensorZeroCopy_TVM) {
   DeleteDLRModel(&model);
 }
 
+TEST(DLR, TestSetOutputTensorZeroCopy_TVM) {
+  auto model = GetDLRModel();
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, 1);
+  int64_t shape[4] = {1, 224, 224, 3};
+  EXPECT_EQ(SetDLRInput(&model, "input_tensor", shape, img.data(), 4), 0);
+
+  alignas(64) float output1_d[1001] = {0};
+  int64_t output1_shape[2] = {1, 1001};
+  DLTensor output1;
+  output1.data = output1_d;
+  output1.device = {kDLCPU, 0};
+  output1.ndim = 2;
+  output1.dtype = {kDLFloat, 32, 1};
+  output1.shape = output1_shape;
+  output1.strides = nullptr;
+  output1.byte_offset = 0;
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 1, &output1), 0);
+  EXPECT_EQ(RunDLRModel(&model), 0);
+  EXPECT_GT(output1_d[112], 0.01);
+  const float* output1_p;
+  EXPECT_EQ(GetDLROutputPtr(&model, 1, (const void**)&output1_p), 0);
+  EXPECT_EQ(output1_p, output1_d);
+  // Copies of the output come from the bound buffer.
+  DLTensor output1_t = GetEmptyDLTensor(2, output1_shape, kDLFloat, 32);
+  EXPECT_EQ(GetDLROutputTensor(&model, 1, &output1_t), 0);
+  DLManagedTensor* output1_m;
+  EXPECT_EQ(GetDLROutputManagedTensorPtr(&model, 1, (const void**)&output1_m), 0);
+  for (int i = 0; i < 1001; i++) {
+    EXPECT_EQ(static_cast<float*>(output1_t.data)[i], output1_d[i]);
+    EXPECT_EQ(static_cast<float*>(output1_m->dl_tensor.data)[i], output1_d[i]);
+  }
+  output1_m->deleter(output1_m);
+  DeleteDLTensor(output1_t);
+
+  // Misaligned buffers are rejected.
+  output1.data = output1_d + 1;
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 1, &output1), -1);
+
+  // Unbinding restores the model's own storage.
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 1, nullptr), 0);
+  output1_d[112] = 0.0f;
+  EXPECT_EQ(RunDLRModel(&model), 0);
+  EXPECT_EQ(output1_d[112], 0.0f);
+  float output1_copy[1001];
+  EXPECT_EQ(GetDLROutput(&model, 1, output1_copy), 0);
+  EXPECT_GT(output1_copy[112], 0.01);
+  DeleteDLRModel(&model);
+}
+
+TEST(DLR, TestSetOutputTensorZeroCopy_RelayVM) {
+  DLRModelHandle model = nullptr;
+  EXPECT_EQ(CreateDLRModel(&model, "./ssd_mobilenet_v1", 1, 0), 0);
+  std::vector<uint8_t> img(512 * 512 * 3, 0);
+  int64_t shape[4] = {1, 512, 512, 3};
+  EXPECT_EQ(SetDLRInput(&model, "image_tensor", shape, img.data(), 4), 0);
+
+  alignas(64) float output3_d[100] = {0};
+  int64_t output3_shape[2] = {1, 100};
+  DLTensor output3;
+  output3.data = output3_d;
+  output3.device = {kDLCPU, 0};
+  output3.ndim = 2;
+  output3.dtype = {kDLFloat, 32, 1};
+  output3.shape = output3_shape;
+  output3.strides = nullptr;
+  output3.byte_offset = 0;
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 3, &output3), 0);
+  EXPECT_EQ(RunDLRModel(&model), 0);
+  // The output is copied into the bound tensor.
+  std::vector<float> output3_copy(100);
+  EXPECT_EQ(GetDLROutput(&model, 3, output3_copy.data()), 0);
+  EXPECT_EQ(std::vector<float>(output3_d, output3_d + 100), output3_copy);
+
+  // Misaligned buffers, other types and shapes are rejected.
+  output3.data = output3_d + 1;
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 3, &output3), -1);
+  output3.data = output3_d;
+  output3.dtype = {kDLInt, 32, 1};
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 3, &output3), -1);
+  output3.dtype = {kDLFloat, 32, 1};
+  output3_shape[1] = 50;
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 3, &output3), -1);
+  EXPECT_EQ(SetDLROutputTensorZeroCopy(&model, 3, nullptr), 0);
+  DeleteDLRModel(&model);
+}
+
+TEST(DLR, TestAllocDLRInputBuffer) {
+  auto model = GetDLRModel();
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, 1);
+  int64_t shape[4] = {1, 224, 224, 3};
+  void* buffer = nullptr;
+  EXPECT_EQ(AllocDLRInputBuffer(&model, "input_tensor", &buffer), 0);
+  EXPECT_EQ(reinterpret_cast<size_t>(buffer) % 64, 0);
+  EXPECT_EQ(AllocDLRInputBuffer(&model, "no_such_input", &buffer), -1);
+  std::copy(img.begin(), img.end(), static_cast<float*>(buffer));
+  // The pooled buffer is bound in place.
+  EXPECT_EQ(SetDLRInput(&model, "input_tensor", shape, buffer, 4), 0);
+  EXPECT_EQ(RunDLRModel(&model), 0);
+  int output0 = -1;
+  EXPECT_EQ(GetDLROutput(&model, 0, &output0), 0);
+  EXPECT_EQ(output0, 112);
+  // Switching back to a regular buffer copies again.
+  EXPECT_EQ(SetDLRInput(&model, "input_tensor", shape, img.data(), 4), 0);
+  EXPECT_EQ(FreeDLRBuffer(buffer), 0);
+  EXPECT_EQ(RunDLRModel(&model), 0);
+  output0 = -1;
+  EXPECT_EQ(GetDLROutput(&model, 0, &output0), 0);
+  EXPECT_EQ(output0, 112);
+  EXPECT_EQ(FreeDLRBuffer(buffer), -1);
+  DeleteDLRModel(&model);
+}
+
 TEST(DLR, TestDLRInputOrder) {
   DLRModelHandle model = nullptr;
   const char* model_path = "./input_order";
@@ -413,6 +532,177 @@ TEST(DLR, TestDLRInputOrder) {
   DeleteDLRModel(&model);
 }
 
+TEST(DLR, TestCreateDLRExecutionContext) {
+  auto model = GetDLRModel();
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, 1);
+  int64_t shape[4] = {1, 224, 224, 3};
+  const char* input_name = "input_tensor";
+
+  const int num_contexts = 4;
+  std::vector<DLRModelHandle> contexts(num_contexts, nullptr);
+  for (int i = 0; i < num_contexts; i++) {
+    EXPECT_EQ(CreateDLRExecutionContext(&model, &contexts[i]), 0);
+    int num_weights;
+    EXPECT_EQ(GetDLRNumWeights(&contexts[i], &num_weights), 0);
+    EXPECT_EQ(num_weights, 108);
+  }
+  // The model must stay usable while contexts exist.
+  DeleteDLRModel(&model);
+
+  std::vector<int> results(num_contexts, -1);
+  std::vector<std::thread> threads;
+  for (int i = 0; i < num_contexts; i++) {
+    threads.emplace_back([&, i]() {
+      for (int iter = 0; iter < 3; iter++) {
+        EXPECT_EQ(SetDLRInput(&contexts[i], input_name, shape, img.data(), 4), 0);
+        EXPECT_EQ(RunDLRModel(&contexts[i]), 0);
+        EXPECT_EQ(GetDLROutput(&contexts[i], 0, &results[i]), 0);
+      }
+    });
+  }
+  for (auto& t : threads) t.join();
+  for (int i = 0; i < num_contexts; i++) {
+    EXPECT_EQ(results[i], 112);
+    DeleteDLRModel(&contexts[i]);
+  }
+}
+
+TEST(DLR, TestRunDLRModelBound) {
+  auto model = GetDLRModel();
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, 1);
+  // Not prepared yet.
+  int output0 = -1;
+  std::vector<float> output1(1001);
+  const void* inputs[1] = {img.data()};
+  void* outputs[2] = {&output0, output1.data()};
+  EXPECT_EQ(RunDLRModelBound(&model, inputs, outputs), -1);
+
+  EXPECT_EQ(PrepareDLRBindings(&model), 0);
+  for (int iter = 0; iter < 3; iter++) {
+    output0 = -1;
+    EXPECT_EQ(RunDLRModelBound(&model, inputs, outputs), 0);
+    EXPECT_EQ(output0, 112);
+    EXPECT_GT(output1[112], 0.01);
+  }
+  DeleteDLRModel(&model);
+}
+
+TEST(DLR, TestRunDLRModelAsync) {
+  auto model = GetDLRModel();
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, 1);
+  int64_t shape[4] = {1, 224, 224, 3};
+  EXPECT_EQ(SetDLRInput(&model, "input_tensor", shape, img.data(), 4), 0);
+
+  std::promise<int> done;
+  auto callback = [](int status, void* user_data) {
+    static_cast<std::promise<int>*>(user_data)->set_value(status);
+  };
+  EXPECT_EQ(RunDLRModelAsync(&model, callback, &done), 0);
+  EXPECT_EQ(done.get_future().get(), 0);
+  int output0[1];
+  EXPECT_EQ(GetDLROutput(&model, 0, output0), 0);
+  EXPECT_EQ(output0[0], 112);
+  DeleteDLRModel(&model);
+}
+
+TEST(DLR, TestCreateDLRModelFromArchive) {
+  const char* archive_path = "./resnet_v1_5_50.dlra";
+  EXPECT_EQ(PackDLRModel("./resnet_v1_5_50", archive_path), 0);
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, 1);
+  int64_t shape[4] = {1, 224, 224, 3};
+  // Weights copied into the executor, then aliasing the archive mapping.
+  for (const char* mmap : {"0", "1"}) {
+    SetEnv("DLR_TVM_PARAMS_MMAP", mmap);
+    DLRModelHandle model = nullptr;
+    EXPECT_EQ(CreateDLRModelFromArchive(&model, archive_path, 1, 0), 0);
+    int num_weights;
+    EXPECT_EQ(GetDLRNumWeights(&model, &num_weights), 0);
+    EXPECT_EQ(num_weights, 108);
+    bool has_metadata;
+    EXPECT_EQ(GetDLRHasMetadata(&model, &has_metadata), 0);
+    EXPECT_TRUE(has_metadata);
+    EXPECT_EQ(SetDLRInput(&model, "input_tensor", shape, img.data(), 4), 0);
+    EXPECT_EQ(RunDLRModel(&model), 0);
+    int output0[1];
+    EXPECT_EQ(GetDLROutput(&model, 0, output0), 0);
+    EXPECT_EQ(output0[0], 112);
+    DeleteDLRModel(&model);
+  }
+  SetEnv("DLR_TVM_PARAMS_MMAP", "0");
+  std::remove(archive_path);
+}
+
+TEST(DLR, TestCreateDLRModelFromInvalidArchive) {
+  DLRModelHandle model = nullptr;
+  // Not an archive.
+  EXPECT_EQ(CreateDLRModelFromArchive(&model, "./resnet_v1_5_50/compiled.meta", 1, 0), -1);
+  EXPECT_NE(std::string(DLRGetLastError()).find("Invalid model archive"), std::string::npos);
+  // Treelite models can not be packed.
+  EXPECT_EQ(PackDLRModel("./xgboost_test", "./xgboost_test.dlra"), -1);
+}
+
+TEST(DLR, TestSaveDLRModelSnapshot) {
+  const char* snapshot_path = "./resnet_v1_5_50_snapshot.dlra";
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, 1);
+  int64_t shape[4] = {1, 224, 224, 3};
+  // Snapshot of weights copied into the executor, then of weights aliasing the params file.
+  for (const char* mmap : {"0", "1"}) {
+    SetEnv("DLR_TVM_PARAMS_MMAP", mmap);
+    DLRModelHandle model = nullptr;
+    EXPECT_EQ(CreateDLRModel(&model, "./resnet_v1_5_50", 1, 0), 0);
+    int num_phases;
+    EXPECT_EQ(GetDLRNumLoadPhases(&model, &num_phases), 0);
+    EXPECT_GT(num_phases, 0);
+    const char* name;
+    double ms;
+    EXPECT_EQ(GetDLRLoadPhase(&model, 0, &name, &ms), 0);
+    EXPECT_STREQ(name, "read_elements");
+    EXPECT_GE(ms, 0);
+    EXPECT_EQ(GetDLRLoadPhase(&model, num_phases, &name, &ms), -1);
+    EXPECT_EQ(SaveDLRModelSnapshot(&model, snapshot_path), 0);
+    DeleteDLRModel(&model);
+
+    SetEnv("DLR_TVM_PARAMS_MMAP", "0");
+    EXPECT_EQ(CreateDLRModelFromArchive(&model, snapshot_path, 1, 0), 0);
+    int num_weights;
+    EXPECT_EQ(GetDLRNumWeights(&model, &num_weights), 0);
+    EXPECT_EQ(num_weights, 108);
+    // The restored weights alias the mapped archive.
+    const dlr::TVMModel* restored =
+        static_cast<const dlr::TVMModel*>(static_cast<dlr::DLRModel*>(model));
+    const dlr::MemoryMappedFile* mapping = restored->GetParamsMapping();
+    ASSERT_NE(mapping, nullptr);
+    for (int i = 0; i < num_weights; i++) {
+      const char* data = static_cast<const char*>(restored->GetWeightData(i));
+      if (data == nullptr) continue;
+      EXPECT_GE(data, mapping->GetData()) << restored->GetWeightName(i);
+      EXPECT_LT(data, mapping->GetData() + mapping->GetSize()) << restored->GetWeightName(i);
+    }
+    EXPECT_EQ(SetDLRInput(&model, "input_tensor", shape, img.data(), 4), 0);
+    EXPECT_EQ(RunDLRModel(&model), 0);
+    int output0[1];
+    EXPECT_EQ(GetDLROutput(&model, 0, output0), 0);
+    EXPECT_EQ(output0[0], 112);
+    DeleteDLRModel(&model);
+    std::remove(snapshot_path);
+  }
+}
+
+TEST(DLR, TestSaveDLRModelSnapshotRelayVM) {
+  DLRModelHandle model = nullptr;
+  EXPECT_EQ(CreateDLRModel(&model, "./ssd_mobilenet_v1", 1, 0), 0);
+  int num_phases;
+  EXPECT_EQ(GetDLRNumLoadPhases(&model, &num_phases), 0);
+  EXPECT_EQ(num_phases, 4);
+  EXPECT_EQ(SaveDLRModelSnapshot(&model, "./ssd_mobilenet_v1.dlra"), -1);
+  DeleteDLRModel(&model);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 #ifndef _WIN32
@@ -2,6 +2,11 @@
 
 #include <gtest/gtest.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 #ifndef _WIN32
@@ -124,3 +129,111 @@ TEST_F(TreeliteTest, TestScoreOutput) {
   EXPECT_NO_THROW(output_p = (float*)model->GetOutputPtr(0));
   EXPECT_EQ(output_p[0], output[0]);
 }
+
+TEST_F(TreeliteTest, TestDenseAndSparseInputsMatch) {
+  // Mostly present values go through the dense path.
+  EXPECT_NO_THROW(model->SetInput("data", in_shape, data.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  float dense_output[1];
+  EXPECT_NO_THROW(model->GetOutput(0, dense_output));
+
+  // Padding the batch with rows of missing values makes the input go through CSR.
+  const int batch = 4;
+  std::vector<float> batch_data(batch * in_size, std::numeric_limits<float>::quiet_NaN());
+  std::copy(data.begin(), data.end(), batch_data.begin());
+  const int64_t batch_shape[2] = {batch, in_size};
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, batch_data.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  float csr_output[batch];
+  EXPECT_NO_THROW(model->GetOutput(0, csr_output));
+  EXPECT_FLOAT_EQ(dense_output[0], csr_output[0]);
+}
+
+TEST_F(TreeliteTest, TestSteadyStateBufferReuse) {
+  const int batch = 8;
+  std::vector<float> batch_data(batch * in_size, 0.0f);
+  // Enough missing values to exercise the CSR buffers.
+  for (size_t i = 0; i < batch_data.size(); i++) {
+    batch_data[i] = (i % 3 == 0) ? data[i % in_size] : std::numeric_limits<float>::quiet_NaN();
+  }
+  const int64_t batch_shape[2] = {batch, in_size};
+  std::vector<float> output(batch);
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, batch_data.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  const size_t num_allocations = model->GetNumBufferAllocations();
+  EXPECT_GT(num_allocations, 0);
+  for (int i = 0; i < 5; i++) {
+    EXPECT_NO_THROW(model->SetInput("data", batch_shape, batch_data.data(), in_dim));
+    EXPECT_NO_THROW(model->Run());
+    EXPECT_NO_THROW(model->GetOutput(0, output.data()));
+  }
+  EXPECT_EQ(model->GetNumBufferAllocations(), num_allocations);
+}
+
+TEST_F(TreeliteTest, TestLargeCSRInputMatchesRowByRow) {
+  // Large enough to build the CSR matrix in parallel.
+  const int batch = 2048;
+  std::vector<float> batch_data(batch * in_size);
+  for (size_t i = 0; i < batch_data.size(); i++) {
+    batch_data[i] = (rand() % 3 == 0) ? static_cast<float>(rand()) / static_cast<float>(RAND_MAX)
+                                      : std::numeric_limits<float>::quiet_NaN();
+  }
+  const int64_t batch_shape[2] = {batch, in_size};
+  std::vector<float> batch_output(batch);
+  EXPECT_NO_THROW(model->SetInput("data", batch_shape, batch_data.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(0, batch_output.data()));
+
+  for (int i = 0; i < batch; i += 97) {
+    float row_output;
+    EXPECT_NO_THROW(model->SetInput("data", in_shape, batch_data.data() + i * in_size, in_dim));
+    EXPECT_NO_THROW(model->Run());
+    EXPECT_NO_THROW(model->GetOutput(0, &row_output));
+    EXPECT_FLOAT_EQ(batch_output[i], row_output);
+  }
+}
+
+TEST_F(TreeliteTest, TestPredictStream) {
+  const size_t num_rows = 1000;
+  std::vector<float> rows(num_rows * in_size);
+  for (auto& v : rows) {
+    v = static_cast<float>(rand()) / static_cast<float>(RAND_MAX);
+  }
+  const int64_t shape[2] = {static_cast<int64_t>(num_rows), in_size};
+  std::vector<float> expected(num_rows);
+  EXPECT_NO_THROW(model->SetInput("data", shape, rows.data(), in_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(model->GetOutput(0, expected.data()));
+
+  // Chunk size does not divide the number of rows.
+  size_t next_row = 0;
+  std::vector<float> streamed;
+  auto reader = [&](float* chunk, size_t max_rows) {
+    const size_t n = std::min(max_rows, num_rows - next_row);
+    std::copy_n(rows.data() + next_row * in_size, n * in_size, chunk);
+    next_row += n;
+    return n;
+  };
+  auto writer = [&](const float* output, size_t n, size_t row_size) {
+    EXPECT_EQ(row_size, 1u);
+    streamed.insert(streamed.end(), output, output + n * row_size);
+  };
+  EXPECT_NO_THROW(model->PredictStream(reader, writer, 128));
+  ASSERT_EQ(streamed.size(), num_rows);
+  for (size_t i = 0; i < num_rows; i++) {
+    EXPECT_FLOAT_EQ(streamed[i], expected[i]);
+  }
+
+  // Same rows from a file.
+  const std::string path = "./treelite_stream_rows.bin";
+  std::ofstream file(path, std::ios::binary);
+  file.write(reinterpret_cast<const char*>(rows.data()), rows.size() * sizeof(float));
+  file.close();
+  streamed.clear();
+  EXPECT_NO_THROW(model->PredictFile(path, writer, 300));
+  std::remove(path.c_str());
+  ASSERT_EQ(streamed.size(), num_rows);
+  for (size_t i = 0; i < num_rows; i++) {
+    EXPECT_FLOAT_EQ(streamed[i], expected[i]);
+  }
+}
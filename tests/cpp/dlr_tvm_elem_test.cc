@@ -1,5 +1,16 @@
 #include <gtest/gtest.h>
 
+#if !defined(_WIN32) && !defined(__ANDROID__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DLR_SHARED_MEMORY_SEGMENTS
+#endif
+
+#include <cstdio>
+#include <cstring>
+
 #include "dlr.h"
 #include "dlr_tvm.h"
 #include "test_utils.hpp"
@@ -49,13 +60,33 @@ TEST_F(TVMElemTest, TestCreateModel_LibTvmIsPointer) {
   std::vector<DLRModelElem> model_elems = {
       {DLRModelElemType::TVM_GRAPH, nullptr, graph_str.c_str(), 0},
       {DLRModelElemType::TVM_PARAMS, nullptr, params_str.data(), params_str.size()},
-      {DLRModelElemType::TVM_LIB, nullptr, so_file.data(), so_file.size()}};
+      {DLRModelElemType::TVM_LIB, nullptr, so_data.data(), so_data.size()}};
+  dlr::TVMModel memory_model(model_elems, dev);
+
+  EXPECT_NO_THROW(model->SetInput("input_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(memory_model.SetInput("input_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(memory_model.Run());
+  std::vector<float> expected(1001);
+  std::vector<float> observed(1001);
+  EXPECT_NO_THROW(model->GetOutput(1, expected.data()));
+  EXPECT_NO_THROW(memory_model.GetOutput(1, observed.data()));
+  EXPECT_EQ(expected, observed);
+}
+
+TEST_F(TVMElemTest, TestCreateModel_LibTvmIsEmpty) {
+  std::string graph_str = dlr::LoadFileToString(graph_file);
+  std::string params_str = dlr::LoadFileToString(params_file, std::ios::in | std::ios::binary);
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, nullptr, graph_str.c_str(), 0},
+      {DLRModelElemType::TVM_PARAMS, nullptr, params_str.data(), params_str.size()},
+      {DLRModelElemType::TVM_LIB, nullptr, nullptr, 0}};
   EXPECT_THROW(
       {
         try {
           new dlr::TVMModel(model_elems, dev);
         } catch (const dmlc::Error& e) {
-          EXPECT_STREQ(e.what(), "Invalid TVM model element TVM_LIB. TVM_LIB must be a file path.");
+          EXPECT_STREQ(e.what(), "Invalid TVM model element TVM_LIB");
           throw;
         }
       },
@@ -98,6 +129,247 @@ TEST_F(TVMElemTest, TestGetInputSize) { EXPECT_EQ(model->GetInputSize(0), 1 * 22
 
 TEST_F(TVMElemTest, TestGetInputDim) { EXPECT_EQ(model->GetInputDim(0), 4); }
 
+TEST_F(TVMElemTest, TestParamsMmap) {
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, graph_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_PARAMS_MMAP, params_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_LIB, so_file.c_str(), nullptr, 0}};
+  dlr::TVMModel mmap_model(model_elems, dev);
+  EXPECT_EQ(mmap_model.GetNumWeights(), model->GetNumWeights());
+  EXPECT_EQ(mmap_model.GetNumInputs(), 1);
+
+  EXPECT_NO_THROW(model->SetInput("input_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(mmap_model.SetInput("input_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(mmap_model.Run());
+  std::vector<float> expected(1001);
+  std::vector<float> observed(1001);
+  EXPECT_NO_THROW(model->GetOutput(1, expected.data()));
+  EXPECT_NO_THROW(mmap_model.GetOutput(1, observed.data()));
+  EXPECT_EQ(expected, observed);
+}
+
+TEST_F(TVMElemTest, TestParamsShared) {
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, graph_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_PARAMS_SHARED, params_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_LIB, so_file.c_str(), nullptr, 0}};
+  size_t stored_bytes, deduplicated_bytes;
+  {
+    dlr::TVMModel first(model_elems, dev);
+    EXPECT_EQ(GetDLRParamStoreStats(&stored_bytes, &deduplicated_bytes), 0);
+    EXPECT_GT(stored_bytes, 0);
+    const size_t model_bytes = stored_bytes;
+    {
+      // The second model holds no weights of its own.
+      dlr::TVMModel second(model_elems, dev);
+      EXPECT_EQ(GetDLRParamStoreStats(&stored_bytes, &deduplicated_bytes), 0);
+      EXPECT_EQ(stored_bytes, model_bytes);
+      EXPECT_EQ(deduplicated_bytes, model_bytes);
+
+      EXPECT_NO_THROW(model->SetInput("input_tensor", input_shape, img.data(), input_dim));
+      EXPECT_NO_THROW(model->Run());
+      EXPECT_NO_THROW(second.SetInput("input_tensor", input_shape, img.data(), input_dim));
+      EXPECT_NO_THROW(second.Run());
+      std::vector<float> expected(1001);
+      std::vector<float> observed(1001);
+      EXPECT_NO_THROW(model->GetOutput(1, expected.data()));
+      EXPECT_NO_THROW(second.GetOutput(1, observed.data()));
+      EXPECT_EQ(expected, observed);
+    }
+    EXPECT_EQ(GetDLRParamStoreStats(&stored_bytes, &deduplicated_bytes), 0);
+    EXPECT_EQ(stored_bytes, model_bytes);
+    EXPECT_EQ(deduplicated_bytes, 0);
+  }
+  EXPECT_EQ(GetDLRParamStoreStats(&stored_bytes, &deduplicated_bytes), 0);
+  EXPECT_EQ(stored_bytes, 0);
+}
+
+TEST_F(TVMElemTest, TestParamsSharedMemory) {
+  std::string params_str = dlr::LoadFileToString(params_file, std::ios::in | std::ios::binary);
+  const std::string segment_name = dlr::GetSharedParamsName(params_str.data(), params_str.size());
+  dlr::SharedMemorySegment::Remove(segment_name);
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, graph_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_PARAMS_SHM, params_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_LIB, so_file.c_str(), nullptr, 0}};
+  // The first model creates the segment, the second one maps it.
+  dlr::TVMModel creator(model_elems, dev);
+  dlr::TVMModel reader(model_elems, dev);
+  EXPECT_EQ(reader.GetNumWeights(), model->GetNumWeights());
+
+  EXPECT_NO_THROW(model->SetInput("input_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  std::vector<float> expected(1001);
+  EXPECT_NO_THROW(model->GetOutput(1, expected.data()));
+  for (dlr::TVMModel* shm_model : {&creator, &reader}) {
+    EXPECT_NO_THROW(shm_model->SetInput("input_tensor", input_shape, img.data(), input_dim));
+    EXPECT_NO_THROW(shm_model->Run());
+    std::vector<float> observed(1001);
+    EXPECT_NO_THROW(shm_model->GetOutput(1, observed.data()));
+    EXPECT_EQ(expected, observed);
+  }
+  EXPECT_EQ(RemoveDLRSharedParams("./resnet_v1_5_50"), 0);
+#ifdef DLR_SHARED_MEMORY_SEGMENTS
+  EXPECT_LT(shm_open(segment_name.c_str(), O_RDONLY, 0), 0);
+
+  // An empty segment is created again instead of waited for.
+  int fd = shm_open(segment_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  ASSERT_GE(fd, 0);
+  close(fd);
+  {
+    dlr::TVMModel recreated(model_elems, dev);
+    EXPECT_NO_THROW(recreated.SetInput("input_tensor", input_shape, img.data(), input_dim));
+    EXPECT_NO_THROW(recreated.Run());
+    std::vector<float> observed(1001);
+    EXPECT_NO_THROW(recreated.GetOutput(1, observed.data()));
+    EXPECT_EQ(expected, observed);
+  }
+  fd = shm_open(segment_name.c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  struct stat st;
+  ASSERT_EQ(fstat(fd, &st), 0);
+  EXPECT_GT(st.st_size, 0);
+  EXPECT_EQ(st.st_mode & 0777, 0600);
+
+  // A segment whose weights do not match the blob is not used and removed.
+  void* addr = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  ASSERT_NE(addr, MAP_FAILED);
+  // Past the 64 bytes header.
+  static_cast<char*>(addr)[64] ^= 0xFF;
+  munmap(addr, st.st_size);
+  {
+    dlr::TVMModel mismatched(model_elems, dev);
+    EXPECT_NO_THROW(mismatched.SetInput("input_tensor", input_shape, img.data(), input_dim));
+    EXPECT_NO_THROW(mismatched.Run());
+    std::vector<float> observed(1001);
+    EXPECT_NO_THROW(mismatched.GetOutput(1, observed.data()));
+    EXPECT_EQ(expected, observed);
+  }
+  EXPECT_LT(shm_open(segment_name.c_str(), O_RDONLY, 0), 0);
+  EXPECT_EQ(RemoveDLRSharedParams("./resnet_v1_5_50"), 0);
+#endif
+}
+
+TEST_F(TVMElemTest, TestParamsCompressed) {
+  const char* compressed_file = "./resnet_v1_5_50_compressed.params";
+#ifdef DLR_ZSTD
+  EXPECT_EQ(CompressDLRParams(params_file.c_str(), compressed_file, 3), 0);
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, graph_file.c_str(), nullptr, 0},
+      {DLRModelElemType::TVM_PARAMS, compressed_file, nullptr, 0},
+      {DLRModelElemType::TVM_LIB, so_file.c_str(), nullptr, 0}};
+  dlr::TVMModel compressed_model(model_elems, dev);
+  EXPECT_EQ(compressed_model.GetNumWeights(), model->GetNumWeights());
+
+  EXPECT_NO_THROW(model->SetInput("input_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(model->Run());
+  EXPECT_NO_THROW(compressed_model.SetInput("input_tensor", input_shape, img.data(), input_dim));
+  EXPECT_NO_THROW(compressed_model.Run());
+  std::vector<float> expected(1001);
+  std::vector<float> observed(1001);
+  EXPECT_NO_THROW(model->GetOutput(1, expected.data()));
+  EXPECT_NO_THROW(compressed_model.GetOutput(1, observed.data()));
+  EXPECT_EQ(expected, observed);
+  std::remove(compressed_file);
+#else
+  EXPECT_EQ(CompressDLRParams(params_file.c_str(), compressed_file, 3), -1);
+#endif  // DLR_ZSTD
+}
+
+/* Compressed params blob of a single weight w, whose frame holds the given bytes. */
+std::string MakeCompressedParams(DLDataType dtype, const std::vector<int64_t>& shape,
+                                 uint64_t size, const std::string& frame) {
+  std::string out;
+  dmlc::MemoryStringStream strm(&out);
+  strm.Write(dlr::kCompressedParamsMagic, sizeof(dlr::kCompressedParamsMagic));
+  strm.Write(dlr::kCompressedParamsVersion);
+  strm.Write(dlr::kCompressedParamsCodecZstd);
+  strm.Write(std::vector<std::string>({"w"}));
+  const int ndim = static_cast<int>(shape.size());
+  const uint64_t offset = 0;
+  const uint64_t frame_size = frame.size();
+  strm.Write(dtype);
+  strm.Write(ndim);
+  if (ndim != 0) strm.WriteArray(shape.data(), ndim);
+  strm.Write(size);
+  strm.Write(offset);
+  strm.Write(frame_size);
+  strm.Write(frame.data(), frame.size());
+  return out;
+}
+
+TEST(CompressedParams, TestReadHeaders) {
+  const DLDataType float32 = {kDLFloat, 32, 1};
+  const std::string frame = "not a zstd frame";
+  const std::string blob = MakeCompressedParams(float32, {3}, 12, frame);
+  std::vector<dlr::CompressedParam> params;
+  ASSERT_NO_THROW(params = dlr::ReadCompressedParams(blob.data(), blob.size()));
+  ASSERT_EQ(params.size(), 1);
+  EXPECT_EQ(params[0].name, "w");
+  EXPECT_EQ(params[0].dtype.code, kDLFloat);
+  EXPECT_EQ(params[0].shape, std::vector<int64_t>({3}));
+  EXPECT_EQ(params[0].size, 12);
+  EXPECT_EQ(params[0].frame, blob.data() + blob.size() - frame.size());
+  EXPECT_EQ(params[0].frame_size, frame.size());
+
+  // Every truncation cuts into the header or the frame.
+  for (size_t size = 0; size < blob.size(); size++) {
+    EXPECT_THROW(dlr::ReadCompressedParams(blob.data(), size), dmlc::Error) << size << " bytes";
+  }
+  // Unknown version and codec.
+  for (size_t offset : {sizeof(dlr::kCompressedParamsMagic),
+                        sizeof(dlr::kCompressedParamsMagic) + sizeof(uint32_t)}) {
+    std::string corrupt = blob;
+    corrupt[offset] = 2;
+    EXPECT_THROW(dlr::ReadCompressedParams(corrupt.data(), corrupt.size()), dmlc::Error);
+  }
+  // Negative number of dimensions.
+  std::string corrupt = MakeCompressedParams(float32, {}, 0, frame);
+  const size_t ndim_offset = corrupt.size() - frame.size() - 3 * sizeof(uint64_t) - sizeof(int);
+  const int negative = -1;
+  std::memcpy(&corrupt[ndim_offset], &negative, sizeof(int));
+  EXPECT_THROW(dlr::ReadCompressedParams(corrupt.data(), corrupt.size()), dmlc::Error);
+  // Frame past the end of the blob.
+  corrupt = blob;
+  const uint64_t frame_size = frame.size() + 1;
+  std::memcpy(&corrupt[blob.size() - frame.size() - sizeof(uint64_t)], &frame_size,
+              sizeof(uint64_t));
+  EXPECT_THROW(dlr::ReadCompressedParams(corrupt.data(), corrupt.size()), dmlc::Error);
+}
+
+TEST(CompressedParams, TestLoadRejected) {
+  // Graph of an input x and a weight w of 3 floats.
+  const std::string graph =
+      "{\"nodes\": [{\"op\": \"null\", \"name\": \"x\", \"inputs\": []}, "
+      "{\"op\": \"null\", \"name\": \"w\", \"inputs\": []}], "
+      "\"arg_nodes\": [0, 1], \"heads\": [[0, 0, 0], [1, 0, 0]], \"node_row_ptr\": [0, 1, 2], "
+      "\"attrs\": {\"dltype\": [\"list_str\", [\"float32\", \"float32\"]], "
+      "\"shape\": [\"list_shape\", [[1, 3], [3]]], \"storage_id\": [\"list_int\", [0, 1]]}}";
+  const DLDevice dev = {kDLCPU, 0};
+  auto load = [&](const std::string& params) {
+    std::vector<DLRModelElem> model_elems = {
+        {DLRModelElemType::TVM_GRAPH, nullptr, graph.c_str(), 0},
+        {DLRModelElemType::TVM_PARAMS, nullptr, params.data(), params.size()},
+        {DLRModelElemType::TVM_LIB, "./resnet_v1_5_50/compiled.so", nullptr, 0}};
+    dlr::TVMModel model(model_elems, dev);
+  };
+  // Weights of the graph's size but of another type or shape are rejected before decompressing.
+  const std::string frame = "not a zstd frame";
+  EXPECT_THROW(load(MakeCompressedParams({kDLInt, 32, 1}, {3}, 12, frame)), dmlc::Error);
+  EXPECT_THROW(load(MakeCompressedParams({kDLFloat, 32, 1}, {1, 3}, 12, frame)), dmlc::Error);
+  // A matching weight whose frame is invalid, or which this build cannot decompress.
+  try {
+    load(MakeCompressedParams({kDLFloat, 32, 1}, {3}, 12, frame));
+    ADD_FAILURE() << "Invalid compressed params were loaded";
+  } catch (const dmlc::Error& e) {
+#ifndef DLR_ZSTD
+    EXPECT_NE(std::string(e.what()).find("USE_ZSTD"), std::string::npos) << e.what();
+#endif  // DLR_ZSTD
+  }
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 #ifndef _WIN32
@@ -2,6 +2,17 @@
 
 #include <gtest/gtest.h>
 
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#endif  // _WIN32
+
+#include <cstdio>
+#include <fstream>
+#include <memory>
+
+#include <nlohmann/json.hpp>
+
 #include "dlr.h"
 #include "test_utils.hpp"
 
@@ -52,6 +63,15 @@ TEST_F(TVMTest, TestGetInputSize) { EXPECT_EQ(model->GetInputSize(0), 1 * 224 *
 
 TEST_F(TVMTest, TestGetInputDim) { EXPECT_EQ(model->GetInputDim(0), 4); }
 
+TEST_F(TVMTest, TestRunAsync) {
+  EXPECT_NO_THROW(model->SetInput("input_tensor", input_shape, img.data(), input_dim));
+  std::future<void> result = model->RunAsync();
+  EXPECT_NO_THROW(result.get());
+  int output[1];
+  EXPECT_NO_THROW(model->GetOutput(0, output));
+  EXPECT_EQ(output[0], 112);
+}
+
 TEST(TVM, TestTvmModelApisWithOutputMetadata) {
   const int device_type = 1;  // 1 - kDLCPU
   const int device_id = 0;
@@ -225,6 +245,244 @@ TEST(TVM, TestTvmModelGetDeviceTypeFromMetadata) {
   std::rename(metadata_file_bak.c_str(), metadata_file.c_str());
 }
 
+TEST(TVM, TestBatchVariants) {
+  std::vector<std::string> files;
+  for (const std::string& file : dlr::FindFiles({"./resnet_v1_5_50"})) {
+    if (!dlr::EndsWith(file, ".meta")) files.push_back(file);
+  }
+  // A variant with the same graph, batches of any size then run as batches of one.
+  nlohmann::json metadata =
+      nlohmann::json::parse(dlr::LoadFileToString("./resnet_v1_5_50/compiled.meta"));
+  metadata["Model"]["BatchVariants"] = {"resnet_v1_5_50"};
+  const std::string meta_file = "./batch_variants.meta";
+  std::ofstream(meta_file) << metadata.dump();
+  files.push_back(meta_file);
+  dlr::TVMModel model(files, DLDevice{kDLCPU, 0});
+
+  const int batch_size = 3;
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, batch_size);
+  int64_t shape[4] = {batch_size, 224, 224, 3};
+  EXPECT_NO_THROW(model.SetInput("input_tensor", shape, img.data(), 4));
+  EXPECT_NO_THROW(model.Run());
+
+  int64_t output_shape[1];
+  EXPECT_NO_THROW(model.GetOutputShape(0, output_shape));
+  EXPECT_EQ(output_shape[0], batch_size);
+  int64_t output_size;
+  int output_dim;
+  EXPECT_NO_THROW(model.GetOutputSizeDim(1, &output_size, &output_dim));
+  EXPECT_EQ(output_size, batch_size * 1001);
+  int output[batch_size];
+  EXPECT_NO_THROW(model.GetOutput(0, output));
+  for (int i = 0; i < batch_size; i++) {
+    EXPECT_EQ(output[i], 112);
+  }
+  std::remove(meta_file.c_str());
+}
+
+TEST(TVM, TestBatchVariantsOfOtherSizes) {
+  // Graphs whose output is their input, for batches of 1 (the model), 2 and 4.
+  const int64_t cols = 3;
+  const std::string lib_file = "./resnet_v1_5_50/compiled.so";
+  const std::string lib = dlr::LoadFileToString(lib_file, std::ios::in | std::ios::binary);
+  for (int64_t batch : {2, 4}) {
+    const std::string dir = "./identity_b" + std::to_string(batch);
+#ifdef _WIN32
+    _mkdir(dir.c_str());
+#else
+    mkdir(dir.c_str(), 0755);
+#endif  // _WIN32
+    std::ofstream(dir + "/compiled.json") << MakeIdentityGraphJson("x", batch, cols);
+    std::ofstream(dir + "/compiled.so", std::ios::binary) << lib;
+  }
+  const std::string graph = MakeIdentityGraphJson("x", 1, cols);
+  const std::string params = MakeEmptyParams();
+  std::ofstream("./identity.json") << graph;
+  std::ofstream("./identity.params", std::ios::binary) << params;
+  nlohmann::json metadata;
+  metadata["Model"]["BatchVariants"] = {"identity_b4", "identity_b2"};
+  std::ofstream("./identity.meta") << metadata.dump();
+  const std::vector<std::string> files = {"./identity.json", "./identity.params", lib_file,
+                                          "./identity.meta"};
+
+  // Outputs of the graph for batch 1, one row at a time.
+  const int64_t rows = 7;
+  std::vector<float> data(rows * cols);
+  for (size_t i = 0; i < data.size(); i++) data[i] = i + 1.0f;
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, nullptr, graph.c_str(), 0},
+      {DLRModelElemType::TVM_PARAMS, nullptr, params.data(), params.size()},
+      {DLRModelElemType::TVM_LIB, lib_file.c_str(), nullptr, 0}};
+  dlr::TVMModel single(model_elems, DLDevice{kDLCPU, 0});
+  std::vector<float> expected(data.size());
+  const int64_t row_shape[2] = {1, cols};
+  for (int64_t r = 0; r < rows; r++) {
+    EXPECT_NO_THROW(single.SetInput("x", row_shape, data.data() + r * cols, 2));
+    EXPECT_NO_THROW(single.Run());
+    EXPECT_NO_THROW(single.GetOutput(0, expected.data() + r * cols));
+  }
+
+  EXPECT_EQ(SetEnv("DLR_TVM_BATCH_CONTEXTS", "2"), 0);
+  dlr::TVMModel model(files, DLDevice{kDLCPU, 0});
+  EXPECT_EQ(SetEnv("DLR_TVM_BATCH_CONTEXTS", ""), 0);
+  EXPECT_EQ(model.GetBatchVariantSizes(), std::vector<int64_t>({1, 2, 4}));
+  std::unique_ptr<dlr::TVMModel> context(model.CreateExecutionContext());
+  EXPECT_EQ(context->GetBatchVariantSizes(), std::vector<int64_t>({1, 2, 4}));
+  // 2 rows run on the batch 2 graph, 7 rows on the batch 4 graph twice, the second run padded.
+  for (dlr::TVMModel* m : {&model, context.get()}) {
+    for (int64_t num_rows : {int64_t{1}, int64_t{2}, rows}) {
+      const int64_t shape[2] = {num_rows, cols};
+      EXPECT_NO_THROW(m->SetInput("x", shape, data.data(), 2));
+      EXPECT_NO_THROW(m->Run());
+      int64_t output_shape[2];
+      EXPECT_NO_THROW(m->GetOutputShape(0, output_shape));
+      EXPECT_EQ(output_shape[0], num_rows);
+      std::vector<float> output(num_rows * cols);
+      EXPECT_NO_THROW(m->GetOutput(0, output.data()));
+      EXPECT_EQ(output, std::vector<float>(expected.begin(), expected.begin() + num_rows * cols))
+          << num_rows << " rows";
+      // Copies of the output have all rows as well.
+      std::vector<float> tensor_output(num_rows * cols);
+      DLTensor tensor = {tensor_output.data(), {kDLCPU, 0}, 2, {kDLFloat, 32, 1},
+                         const_cast<int64_t*>(shape), nullptr, 0};
+      EXPECT_NO_THROW(m->GetOutputTensor(0, &tensor));
+      EXPECT_EQ(tensor_output, output);
+      const DLManagedTensor* managed = nullptr;
+      EXPECT_NO_THROW(m->GetOutputManagedTensorPtr(0, &managed));
+      ASSERT_NE(managed, nullptr);
+      EXPECT_EQ(managed->dl_tensor.shape[0], num_rows);
+      const float* managed_data = static_cast<const float*>(managed->dl_tensor.data);
+      EXPECT_EQ(std::vector<float>(managed_data, managed_data + num_rows * cols), output);
+      managed->deleter(const_cast<DLManagedTensor*>(managed));
+    }
+  }
+
+  for (const char* file : {"./identity.json", "./identity.params", "./identity.meta",
+                           "./identity_b2/compiled.json", "./identity_b2/compiled.so",
+                           "./identity_b4/compiled.json", "./identity_b4/compiled.so"}) {
+    std::remove(file);
+  }
+  std::remove("./identity_b2");
+  std::remove("./identity_b4");
+}
+
+TEST(TVM, TestBatchTiling) {
+  // Graph is compiled for batch 1, larger batches run as several batches of one.
+  EXPECT_EQ(SetEnv("DLR_TVM_BATCH_CONTEXTS", "2"), 0);
+  dlr::TVMModel model(dlr::FindFiles({"./resnet_v1_5_50"}), DLDevice{kDLCPU, 0});
+
+  const int batch_size = 5;
+  size_t img_size = 224 * 224 * 3;
+  std::vector<float> img = LoadImageAndPreprocess("cat224-3.txt", img_size, batch_size);
+  int64_t shape[4] = {batch_size, 224, 224, 3};
+  EXPECT_NO_THROW(model.SetInput("input_tensor", shape, img.data(), 4));
+  EXPECT_EQ(SetEnv("DLR_TVM_BATCH_CONTEXTS", ""), 0);
+  EXPECT_NO_THROW(model.Run());
+
+  int64_t output_shape[2];
+  EXPECT_NO_THROW(model.GetOutputShape(1, output_shape));
+  EXPECT_EQ(output_shape[0], batch_size);
+  EXPECT_EQ(output_shape[1], 1001);
+  int output[batch_size];
+  EXPECT_NO_THROW(model.GetOutput(0, output));
+  for (int i = 0; i < batch_size; i++) {
+    EXPECT_EQ(output[i], 112);
+  }
+  std::vector<float> probs(batch_size * 1001);
+  EXPECT_NO_THROW(model.GetOutput(1, probs.data()));
+  std::vector<float> tensor_probs(probs.size());
+  DLTensor probs_tensor = {tensor_probs.data(), {kDLCPU, 0}, 2, {kDLFloat, 32, 1},
+                           output_shape, nullptr, 0};
+  EXPECT_NO_THROW(model.GetOutputTensor(1, &probs_tensor));
+  EXPECT_EQ(tensor_probs, probs);
+  const DLManagedTensor* managed = nullptr;
+  EXPECT_NO_THROW(model.GetOutputManagedTensorPtr(1, &managed));
+  ASSERT_NE(managed, nullptr);
+  EXPECT_EQ(managed->dl_tensor.shape[0], batch_size);
+  const float* managed_probs = static_cast<const float*>(managed->dl_tensor.data);
+  EXPECT_EQ(std::vector<float>(managed_probs, managed_probs + probs.size()), probs);
+  managed->deleter(const_cast<DLManagedTensor*>(managed));
+  std::vector<float> input(img.size());
+  EXPECT_NO_THROW(model.GetInput("input_tensor", input.data()));
+  EXPECT_EQ(input, img);
+
+  // Inputs with other dimensions than the batch still have to match.
+  int64_t bad_shape[4] = {batch_size, 224, 112, 6};
+  EXPECT_THROW(model.SetInput("input_tensor", bad_shape, img.data(), 4), dmlc::Error);
+
+  // An input of the graph's batch size switches back to running the graph directly.
+  EXPECT_EQ(model.GetBatchVariantSizes(), std::vector<int64_t>({1}));
+  int64_t single_shape[4] = {1, 224, 224, 3};
+  EXPECT_NO_THROW(model.SetInput("input_tensor", single_shape, img.data(), 4));
+  EXPECT_TRUE(model.GetBatchVariantSizes().empty());
+  EXPECT_NO_THROW(model.Run());
+  EXPECT_NO_THROW(model.GetOutputShape(1, output_shape));
+  EXPECT_EQ(output_shape[0], 1);
+  EXPECT_NO_THROW(model.GetOutput(0, output));
+  EXPECT_EQ(output[0], 112);
+
+  // SetInputTensor tiles other batch sizes like SetInput.
+  DLTensor tensor;
+  tensor.data = img.data();
+  tensor.device = {kDLCPU, 0};
+  tensor.ndim = 4;
+  tensor.dtype = {kDLFloat, 32, 1};
+  tensor.shape = shape;
+  tensor.strides = nullptr;
+  tensor.byte_offset = 0;
+  EXPECT_NO_THROW(model.SetInputTensor("input_tensor", &tensor));
+  EXPECT_EQ(model.GetBatchVariantSizes(), std::vector<int64_t>({1}));
+  EXPECT_NO_THROW(model.Run());
+  EXPECT_NO_THROW(model.GetOutputShape(1, output_shape));
+  EXPECT_EQ(output_shape[0], batch_size);
+  EXPECT_NO_THROW(model.GetOutput(0, output));
+  for (int i = 0; i < batch_size; i++) {
+    EXPECT_EQ(output[i], 112);
+  }
+}
+
+TEST(TVM, TestBatchTilingNeedsBatchDim) {
+  // Graph of batch 1 whose second output, the weight w, has no batch dimension.
+  const std::string lib_file = "./resnet_v1_5_50/compiled.so";
+  const std::string graph =
+      "{\"nodes\": [{\"op\": \"null\", \"name\": \"x\", \"inputs\": []}, "
+      "{\"op\": \"null\", \"name\": \"w\", \"inputs\": []}], "
+      "\"arg_nodes\": [0, 1], \"heads\": [[0, 0, 0], [1, 0, 0]], \"node_row_ptr\": [0, 1, 2], "
+      "\"attrs\": {\"dltype\": [\"list_str\", [\"float32\", \"float32\"]], "
+      "\"shape\": [\"list_shape\", [[1, 3], [3]]], \"storage_id\": [\"list_int\", [0, 1]]}}";
+  const std::vector<float> weight = {4.0f, 5.0f, 6.0f};
+  tvm::runtime::NDArray w = tvm::runtime::NDArray::Empty({3}, {kDLFloat, 32, 1}, {kDLCPU, 0});
+  w.CopyFromBytes(weight.data(), weight.size() * sizeof(float));
+  std::string params;
+  dmlc::MemoryStringStream strm(&params);
+  strm.Write(tvm::runtime::kTVMNDArrayListMagic);
+  strm.Write(static_cast<uint64_t>(0));
+  strm.Write(std::vector<std::string>({"w"}));
+  strm.Write(static_cast<uint64_t>(1));
+  w.Save(&strm);
+  std::vector<DLRModelElem> model_elems = {
+      {DLRModelElemType::TVM_GRAPH, nullptr, graph.c_str(), 0},
+      {DLRModelElemType::TVM_PARAMS, nullptr, params.data(), params.size()},
+      {DLRModelElemType::TVM_LIB, lib_file.c_str(), nullptr, 0}};
+  dlr::TVMModel model(model_elems, DLDevice{kDLCPU, 0});
+
+  // Other batch sizes are refused as a size mismatch instead of tiled.
+  const std::vector<float> data = {1.0f, 2.0f, 3.0f, 4.0f, 5.0f, 6.0f};
+  const int64_t batch_shape[2] = {2, 3};
+  EXPECT_THROW(model.SetInput("x", batch_shape, data.data(), 2), dmlc::Error);
+  EXPECT_TRUE(model.GetBatchVariantSizes().empty());
+
+  const int64_t shape[2] = {1, 3};
+  EXPECT_NO_THROW(model.SetInput("x", shape, data.data(), 2));
+  EXPECT_NO_THROW(model.Run());
+  std::vector<float> output(3);
+  EXPECT_NO_THROW(model.GetOutput(0, output.data()));
+  EXPECT_EQ(output, std::vector<float>(data.begin(), data.begin() + 3));
+  EXPECT_NO_THROW(model.GetOutput(1, output.data()));
+  EXPECT_EQ(output, weight);
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 #ifndef _WIN32
@@ -3,12 +3,16 @@
 
 #include <dlpack/dlpack.h>
 #include <dmlc/logging.h>
+#include <dmlc/memory_io.h>
+#include <tvm/runtime/ndarray.h>
 
 #include <stdlib.h>
 #include <cstring>
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 void* alligned_malloc(size_t size, size_t align) {
   void* ptr;
@@ -113,4 +117,27 @@ int SetEnv(const char* key, const char* value) {
 #endif  // _WIN32
 }
 
+/* Graph JSON whose only output is its float32 input of shape {batch, cols}. It runs no operator,
+ * so it can be loaded with any library, e.g. to test graphs of several batch sizes. */
+std::string MakeIdentityGraphJson(const std::string& name, int64_t batch, int64_t cols) {
+  std::ostringstream json;
+  json << "{\"nodes\": [{\"op\": \"null\", \"name\": \"" << name << "\", \"inputs\": []}], "
+       << "\"arg_nodes\": [0], \"heads\": [[0, 0, 0]], \"node_row_ptr\": [0, 1], "
+       << "\"attrs\": {\"dltype\": [\"list_str\", [\"float32\"]], "
+       << "\"shape\": [\"list_shape\", [[" << batch << ", " << cols << "]]], "
+       << "\"storage_id\": [\"list_int\", [0]]}}";
+  return json.str();
+}
+
+/* Params blob without any weights. */
+std::string MakeEmptyParams() {
+  std::string params;
+  dmlc::MemoryStringStream strm(&params);
+  strm.Write(tvm::runtime::kTVMNDArrayListMagic);
+  strm.Write(static_cast<uint64_t>(0));
+  strm.Write(std::vector<std::string>());
+  strm.Write(static_cast<uint64_t>(0));
+  return params;
+}
+
 #endif